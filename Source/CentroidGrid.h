@@ -0,0 +1,186 @@
+/*
+  ==============================================================================
+
+    CentroidGrid.h
+    Created: 16 Oct 2026 7:35:42pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CentroidStore.h"
+#include <vector>
+
+// uniform grid over the first two (normalized) feature axes, hashed into a fixed
+// bucket table, indexing the centroids of a CentroidStore by position. centroids
+// can be inserted and moved one at a time, so it follows RTEFC's exponential
+// updates; a lookup only visits the cells around the query, so it stays near O(1)
+// as the cluster count grows. costs use every dimension: the 2D cell distance
+// bounds them from below, so the ring search stays exact. sized in allocate(),
+// never allocates after
+template <int Dim, typename Metric = WeightedEuclidean>
+class CentroidGrid
+{
+public:
+    using Store = CentroidStore<Dim, Metric>;
+    using Point = typename Store::Point;
+    
+    void allocate(int maxCentroids)
+    {
+        // about two buckets per centroid keeps collisions rare
+        const int numBuckets = juce::nextPowerOfTwo(std::max(64, 2 * maxCentroids));
+        bucketMask = numBuckets - 1;
+        
+        heads.assign((size_t) numBuckets, -1);
+        next.assign((size_t) maxCentroids, -1);
+        prev.assign((size_t) maxCentroids, -1);
+        cells.assign((size_t) maxCentroids, {});
+    }
+    
+    // forgets every centroid, keeps the cell size
+    void clear() noexcept
+    {
+        std::fill(heads.begin(), heads.end(), -1);
+    }
+    
+    float getCellSize() const noexcept { return cellSize; }
+    
+    // changes the cell size and re-indexes every centroid in the store
+    void rebuild(float newCellSize, const Store& centroids) noexcept
+    {
+        cellSize = std::max(1.0e-3f, newCellSize);
+        inverseCellSize = 1.0f / cellSize;
+        
+        clear();
+        for (int i = 0; i < std::min(centroids.size(), (int) cells.size()); ++i)
+            insert(i, centroids[i]);
+    }
+    
+    void insert(int index, const Point& p) noexcept
+    {
+        if (index < 0 || index >= (int) cells.size())
+            return;
+        
+        link(index, cellOf(p));
+    }
+    
+    void move(int index, const Point& p) noexcept
+    {
+        if (index < 0 || index >= (int) cells.size())
+            return;
+        
+        // the exponential update nudges centroids, so most moves stay in their cell
+        const Cell c = cellOf(p);
+        if (c == cells[(size_t) index])
+            return;
+        
+        unlink(index);
+        link(index, c);
+    }
+    
+    // closest indexed centroid and its cost. searches rings of cells outwards and
+    // gives up (-1) past maxSearchRings, in which case the caller should fall back
+    // to a full scan
+    int nearest(const Point& p, const Store& centroids, float& bestCost) const noexcept
+    {
+        bestCost = std::numeric_limits<float>::max();
+        int best = -1;
+        
+        // a term only grows with |delta|, so the cheaper of the two indexed axes bounds
+        // the cost of any centroid a given number of cells away
+        const auto& coefficients = centroids.getCoefficients();
+        const float boundCoefficient = std::min(coefficients[0], coefficients[1]);
+        
+        const Cell centre = cellOf(p);
+        for (int r = 0; r <= maxSearchRings; ++r)
+        {
+            // only the cells on the border of the (2r+1)^2 square are new this ring
+            for (int dy = -r; dy <= r; ++dy)
+            {
+                const bool edgeRow = (dy == -r || dy == r);
+                for (int dx = -r; dx <= r; dx += (edgeRow || r == 0) ? 1 : 2 * r)
+                {
+                    const Cell c { centre.x + dx, centre.y + dy };
+                    for (int i = heads[(size_t) bucketOf(c)]; i >= 0; i = next[(size_t) i])
+                    {
+                        if (! (cells[(size_t) i] == c))
+                            continue; // hash collision with another cell
+                        
+                        const float cost = centroids.cost(i, p);
+                        if (cost < bestCost || (cost == bestCost && i < best))
+                        {
+                            bestCost = cost;
+                            best = i;
+                        }
+                    }
+                }
+            }
+            
+            // everything beyond ring r is at least r cells away
+            if (best >= 0 && bestCost <= Metric::term((float) r * cellSize, boundCoefficient))
+                return best;
+        }
+        
+        bestCost = std::numeric_limits<float>::max();
+        return -1;
+    }
+    
+private:
+    struct Cell
+    {
+        int x = 0, y = 0;
+        bool operator== (const Cell& o) const noexcept { return x == o.x && y == o.y; }
+    };
+    
+    static constexpr int maxSearchRings = 6;
+    
+    Cell cellOf(const Point& p) const noexcept
+    {
+        // clamped so far-out features can't overflow the cell coordinates
+        constexpr float limit = 1 << 20;
+        return { (int) std::floor(juce::jlimit(-limit, limit, p[0] * inverseCellSize)),
+                 (int) std::floor(juce::jlimit(-limit, limit, p[1] * inverseCellSize)) };
+    }
+    
+    int bucketOf(const Cell& c) const noexcept
+    {
+        const auto h = ((juce::uint32) c.x * 73856093u) ^ ((juce::uint32) c.y * 19349663u);
+        return (int) (h & (juce::uint32) bucketMask);
+    }
+    
+    void link(int index, const Cell& c) noexcept
+    {
+        const int b = bucketOf(c);
+        cells[(size_t) index] = c;
+        prev[(size_t) index] = -1;
+        next[(size_t) index] = heads[(size_t) b];
+        if (heads[(size_t) b] >= 0)
+            prev[(size_t) heads[(size_t) b]] = index;
+        heads[(size_t) b] = index;
+    }
+    
+    void unlink(int index) noexcept
+    {
+        const int p = prev[(size_t) index];
+        const int n = next[(size_t) index];
+        
+        if (p >= 0) next[(size_t) p] = n;
+        else        heads[(size_t) bucketOf(cells[(size_t) index])] = n;
+        
+        if (n >= 0) prev[(size_t) n] = p;
+    }
+    
+    // per bucket: first centroid; per centroid: its cell and neighbours in the bucket
+    std::vector<int> heads;
+    std::vector<int> next, prev;
+    std::vector<Cell> cells;
+    int bucketMask = 0;
+    
+    float cellSize = 1.0f;
+    float inverseCellSize = 1.0f;
+    
+    static_assert(Dim >= 2, "the grid indexes the first two axes");
+};
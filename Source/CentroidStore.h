@@ -0,0 +1,229 @@
+/*
+  ==============================================================================
+
+    CentroidStore.h
+    Created: 16 Oct 2026 6:48:13pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ClusterMetrics.h"
+#include <vector>
+#include <array>
+
+// the centroids of one clustering, kept as one SIMD-aligned column per dimension
+// so nearest-centroid searches can test a whole register of centroids at once.
+// the columns are padded to the SIMD width with far-away dummies, so the kernels
+// never need a scalar tail. Dim and the metric are fixed at compile time, so the
+// per-dimension loops unroll. sized once in allocate(), never allocates after
+template <int Dim, typename Metric = WeightedEuclidean>
+class CentroidStore
+{
+public:
+    static_assert(Dim >= 1, "need at least one dimension");
+    
+    static constexpr int dimension = Dim;
+    using Point = std::array<float, (size_t) Dim>;
+    
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    static constexpr int simdWidth = (int) Vec::SIMDNumElements;
+   #else
+    static constexpr int simdWidth = 1;
+   #endif
+    
+    void allocate(int maxCentroids)
+    {
+        stride = std::max(1, (maxCentroids + simdWidth - 1) / simdWidth) * simdWidth;
+        
+        // one extra register's worth so the columns can start on an aligned address
+        storage.assign((size_t) (Dim * stride + simdWidth), farAway);
+        count = 0;
+        coefficients.fill(1.0f);
+    }
+    
+    int size() const noexcept { return count; }
+    int capacity() const noexcept { return stride; }
+    bool empty() const noexcept { return count == 0; }
+    
+    // growing adds centroids at the origin; both are no-ops past capacity
+    void resize(int newSize) noexcept
+    {
+        newSize = juce::jlimit(0, stride, newSize);
+        
+        for (int i = count; i < newSize; ++i)
+            set(i, Point {});
+        
+        Point far;
+        far.fill(farAway);
+        for (int i = newSize; i < count; ++i)
+            set(i, far);
+        
+        count = newSize;
+    }
+    
+    void clear() noexcept { resize(0); }
+    
+    bool push_back(const Point& p) noexcept
+    {
+        if (count >= stride)
+            return false;
+        
+        set(count++, p);
+        return true;
+    }
+    
+    Point operator[](int i) const noexcept
+    {
+        Point p;
+        for (int d = 0; d < Dim; ++d)
+            p[(size_t) d] = column(d)[i];
+        return p;
+    }
+    
+    void set(int i, const Point& p) noexcept
+    {
+        jassert(i >= 0 && i < stride);
+        for (int d = 0; d < Dim; ++d)
+            column(d)[i] = p[(size_t) d];
+    }
+    
+    const float* column(int d) const noexcept { return base() + d * stride; }
+    
+    // per-axis coefficients handed to Metric::term, 1 after allocate()
+    void setCoefficients(const Point& c) noexcept { coefficients = c; }
+    const Point& getCoefficients() const noexcept { return coefficients; }
+    
+    // the metric's cost between centroid i and p
+    float cost(int i, const Point& p) const noexcept
+    {
+        float c = 0.0f;
+        for (int d = 0; d < Dim; ++d)
+            c += Metric::term(column(d)[i] - p[(size_t) d], coefficients[(size_t) d]);
+        return c;
+    }
+    
+    // index of the closest centroid and its cost, -1 if empty.
+    // ties go to the lowest index, like a plain scan
+    int nearest(const Point& p, float& bestCost) const noexcept
+    {
+        float unused;
+        return search<false>(p, bestCost, unused);
+    }
+    
+    int nearest(const Point& p) const noexcept { float c; return nearest(p, c); }
+    
+    // as nearest(), also reporting the cost of the runner-up
+    int nearestTwo(const Point& p, float& bestCost, float& secondCost) const noexcept
+    {
+        return search<true>(p, bestCost, secondCost);
+    }
+    
+private:
+    // costs +inf or close to it under every metric, so padding never wins a comparison
+    static constexpr float farAway = 1.0e30f;
+    
+    std::vector<float> storage;
+    Point coefficients {};
+    int stride = 0; // capacity, a multiple of simdWidth
+    int count = 0;
+    
+    // the vector's own alignment isn't enough for aligned SIMD loads; recomputed on
+    // every access so copies of the store stay valid
+    float* base() const noexcept
+    {
+        auto* data = const_cast<float*>(storage.data());
+       #if JUCE_USE_SIMD
+        return Vec::getNextSIMDAlignedPtr(data);
+       #else
+        return data;
+       #endif
+    }
+    
+    float* column(int d) noexcept { return base() + d * stride; }
+    
+    int paddedCount() const noexcept { return (count + simdWidth - 1) / simdWidth * simdWidth; }
+    
+    template <bool withRunnerUp>
+    int search(const Point& p, float& bestCost, float& secondCost) const noexcept
+    {
+        bestCost = secondCost = std::numeric_limits<float>::max();
+        if (count == 0)
+            return -1;
+        
+        int best = -1;
+        
+       #if JUCE_USE_SIMD
+        // per-lane running minimum and the (float-coded) index that produced it; strict
+        // less-than keeps the first index on ties, as the scalar scan does
+        std::array<Vec, (size_t) Dim> query, coefficient;
+        for (int d = 0; d < Dim; ++d)
+        {
+            query[(size_t) d] = Vec::expand(p[(size_t) d]);
+            coefficient[(size_t) d] = Vec::expand(coefficients[(size_t) d]);
+        }
+        
+        const Vec none = Vec::expand(std::numeric_limits<float>::max());
+        const Vec step = Vec::expand((float) simdWidth);
+        Vec index, best1 = none, best2 = none, bestIndex = Vec::expand(-1.0f);
+        for (int lane = 0; lane < simdWidth; ++lane)
+            index.set((size_t) lane, (float) lane);
+        
+        for (int i = 0; i < paddedCount(); i += simdWidth)
+        {
+            Vec c = Vec::expand(0.0f);
+            for (int d = 0; d < Dim; ++d)
+            {
+                const Vec delta = Vec::fromRawArray(column(d) + i) - query[(size_t) d];
+                c += Metric::term(delta, coefficient[(size_t) d]);
+            }
+            
+            const auto closer = Vec::lessThan(c, best1);
+            
+            // the runner-up is the old best if c took its place, otherwise min(runner-up, c)
+            if constexpr (withRunnerUp)
+                best2 = Vec::min(best2, Vec::max(c, best1));
+            
+            best1 = Vec::min(best1, c);
+            bestIndex = (index & closer) + (bestIndex & ~closer);
+            index += step;
+        }
+        
+        for (int lane = 0; lane < simdWidth; ++lane)
+        {
+            const float c = best1.get((size_t) lane);
+            const int idx = (int) bestIndex.get((size_t) lane);
+            if (c < bestCost || (c == bestCost && idx >= 0 && idx < best))
+            {
+                bestCost = c;
+                best = idx;
+            }
+        }
+        
+        // the winning lane's runner-up competes with every other lane's best
+        if constexpr (withRunnerUp)
+        {
+            for (int lane = 0; lane < simdWidth; ++lane)
+            {
+                secondCost = std::min(secondCost, best2.get((size_t) lane));
+                if ((int) bestIndex.get((size_t) lane) != best)
+                    secondCost = std::min(secondCost, best1.get((size_t) lane));
+            }
+        }
+       #else
+        for (int i = 0; i < count; ++i)
+        {
+            const float c = cost(i, p);
+            
+            if (c < bestCost)        { secondCost = bestCost; bestCost = c; best = i; }
+            else if (c < secondCost) { secondCost = c; }
+        }
+       #endif
+        
+        return best;
+    }
+};
@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    ClusterMetrics.h
+    Created: 16 Oct 2026 9:12:40pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <cmath>
+
+// distance policies for ClusterSpace. a metric sums one term per axis into a cost,
+// which is what the nearest-centroid searches minimize, and toDistance() turns a
+// cost into a true distance for radii and triangle-inequality bounds. term() is
+// written for both floats and SIMD registers, and the metric is a template
+// argument, so switching metrics never adds a branch to the search loops.
+//
+// axis weights (the length weight) are folded into the coordinates when a point
+// is normalized, so the per-axis coefficient is only there for metrics that adapt
+// to the data. metrics with adaptive == false ignore it and it compiles away
+
+// sqrt(sum (w x)^2), the engines' default
+struct WeightedEuclidean
+{
+    static constexpr bool adaptive = false;
+    
+    template <typename T>
+    static T term(T delta, T) noexcept { return delta * delta; }
+    
+    static float toDistance(float cost) noexcept { return std::sqrt(std::max(0.0f, cost)); }
+    static float toCost(float distance) noexcept { return distance * distance; }
+};
+
+// sqrt(sum (w x)^2 / v), with v the within-cluster variance along each axis, so an
+// axis the clusters are tight on counts for more than one they sprawl along. the
+// coefficient is 1 / v, fed from the residuals through ClusterSpace::setAxisSpread
+struct MahalanobisDiagonal
+{
+    static constexpr bool adaptive = true;
+    
+    template <typename T>
+    static T term(T delta, T inverseVariance) noexcept { return inverseVariance * delta * delta; }
+    
+    static float toDistance(float cost) noexcept { return std::sqrt(std::max(0.0f, cost)); }
+    static float toCost(float distance) noexcept { return distance * distance; }
+};
+
+// sum |w x|. cheaper per term and less swayed by one outlying axis
+struct WeightedL1
+{
+    static constexpr bool adaptive = false;
+    
+    static float term(float delta, float) noexcept { return std::abs(delta); }
+    
+   #if JUCE_USE_SIMD
+    static juce::dsp::SIMDRegister<float> term(juce::dsp::SIMDRegister<float> delta,
+                                               juce::dsp::SIMDRegister<float>) noexcept
+    {
+        return juce::dsp::SIMDRegister<float>::abs(delta);
+    }
+   #endif
+    
+    static float toDistance(float cost) noexcept { return cost; }
+    static float toCost(float distance) noexcept { return distance; }
+};
@@ -0,0 +1,187 @@
+/*
+  ==============================================================================
+
+    ClusterSpace.h
+    Created: 16 Oct 2026 9:20:03pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "CentroidStore.h"
+#include "ClusterMetrics.h"
+#include <vector>
+#include <array>
+
+// the part both engines share: how raw features become coordinates, how far apart
+// two coordinates are, and the centroids with one representative each. Dim and
+// Metric are template arguments, so the normalization and search loops unroll and
+// never branch on either; Representative is whatever the engine needs to find a
+// cluster's audio again. sized in allocate(), never allocates after
+template <int Dim, typename Metric, typename Representative>
+class ClusterSpace
+{
+public:
+    static constexpr int dimension = Dim;
+    static constexpr bool adaptiveMetric = Metric::adaptive;
+    
+    using Point = std::array<float, (size_t) Dim>;
+    using Store = CentroidStore<Dim, Metric>;
+    
+    ClusterSpace()
+    {
+        spread.fill(1.0f);
+        weight.fill(1.0f);
+        updateScale();
+    }
+    
+    void allocate(int maxClusters)
+    {
+        centroids.allocate(maxClusters);
+        representatives.reserve((size_t) maxClusters);
+    }
+    
+    //==========================================================================
+    // normalization: x -> (f(x) - centre) / spread * weight, where f is log on
+    // logarithmic axes and the identity elsewhere
+    
+    void setNormalization(const Point& newCentre, const Point& newSpread) noexcept
+    {
+        centre = newCentre;
+        spread = newSpread;
+        updateScale();
+    }
+    
+    void setAxisWeight(int axis, float w) noexcept
+    {
+        weight[(size_t) axis] = w;
+        updateScale();
+    }
+    
+    float getAxisWeight(int axis) const noexcept { return weight[(size_t) axis]; }
+    
+    void setLogarithmic(int axis, bool isLog) noexcept { logarithmic[(size_t) axis] = isLog; }
+    bool isLogarithmic(int axis) const noexcept { return logarithmic[(size_t) axis]; }
+    
+    Point normalize(const Point& raw) const noexcept
+    {
+        Point x;
+        for (size_t d = 0; d < x.size(); ++d)
+        {
+            const float v = logarithmic[d] ? std::log(std::max(1.0e-6f, raw[d])) : raw[d];
+            x[d] = (v - centre[d]) * scale[d];
+        }
+        return x;
+    }
+    
+    //==========================================================================
+    // metric
+    
+    // the within-cluster variance along each axis, in standardized units (before
+    // the axis weights, so 1 means as spread out as the data as a whole). only
+    // adaptive metrics look at it; for the others this is a no-op
+    void setAxisSpread(const Point& variance) noexcept
+    {
+        if constexpr (adaptiveMetric)
+        {
+            // floored at a 1% standard deviation so one collapsed axis can't take over
+            Point c;
+            for (size_t d = 0; d < c.size(); ++d)
+                c[d] = 1.0f / std::max(variance[d], 1.0e-4f);
+            centroids.setCoefficients(c);
+        }
+        else
+        {
+            juce::ignoreUnused(variance);
+        }
+    }
+    
+    // back to the plain weighted metric, as if every axis had unit spread
+    void resetAxisSpread() noexcept
+    {
+        Point c;
+        c.fill(1.0f);
+        centroids.setCoefficients(c);
+    }
+    
+    // what searches minimize; monotonic in distance()
+    float cost(const Point& a, const Point& b) const noexcept
+    {
+        const auto& c = centroids.getCoefficients();
+        float sum = 0.0f;
+        for (size_t d = 0; d < a.size(); ++d)
+            sum += Metric::term(a[d] - b[d], c[d]);
+        return sum;
+    }
+    
+    float distance(const Point& a, const Point& b) const noexcept { return Metric::toDistance(cost(a, b)); }
+    
+    static float costToDistance(float c) noexcept { return Metric::toDistance(c); }
+    
+    //==========================================================================
+    // clusters
+    
+    int size() const noexcept { return centroids.size(); }
+    bool empty() const noexcept { return centroids.empty(); }
+    int capacity() const noexcept { return centroids.capacity(); }
+    
+    void clear() noexcept
+    {
+        centroids.clear();
+        representatives.clear();
+    }
+    
+    // new clusters sit at the origin with a default representative
+    void resize(int numClusters) noexcept
+    {
+        centroids.resize(numClusters);
+        representatives.assign((size_t) centroids.size(), {});
+    }
+    
+    // false once capacity is reached
+    bool add(const Point& centroid, const Representative& rep) noexcept
+    {
+        if (! centroids.push_back(centroid))
+            return false;
+        
+        representatives.push_back(rep);
+        return true;
+    }
+    
+    Point getCentroid(int i) const noexcept { return centroids[i]; }
+    void setCentroid(int i, const Point& p) noexcept { centroids.set(i, p); }
+    
+    const Representative& getRepresentative(int i) const noexcept { return representatives[(size_t) i]; }
+    void setRepresentative(int i, const Representative& rep) noexcept { representatives[(size_t) i] = rep; }
+    
+    // index of the closest centroid and its distance, -1 if there are none
+    int nearest(const Point& p, float& distanceFound) const noexcept
+    {
+        float c = 0.0f;
+        const int best = centroids.nearest(p, c);
+        distanceFound = Metric::toDistance(c);
+        return best;
+    }
+    
+    int nearest(const Point& p) const noexcept { return centroids.nearest(p); }
+    
+    // the raw store, for bulk searches and spatial indexes
+    const Store& getCentroids() const noexcept { return centroids; }
+    Store& getCentroids() noexcept { return centroids; }
+    
+private:
+    void updateScale() noexcept
+    {
+        for (size_t d = 0; d < scale.size(); ++d)
+            scale[d] = weight[d] / spread[d];
+    }
+    
+    Point centre {}, spread {}, weight {}, scale {};
+    std::array<bool, (size_t) Dim> logarithmic {};
+    
+    Store centroids;
+    std::vector<Representative> representatives;
+};
@@ -21,10 +21,6 @@ const std::vector<juce::Colour> ClusterVisualizationComponent::clusterColors = {
 ClusterVisualizationComponent::ClusterVisualizationComponent(RTWavesetsAudioProcessor& processor)
     : audioProcessor(processor)
 {
-    cachedCentroids.reserve(32);
-    cachedRecentPoints.reserve(100);
-    cachedAssignments.reserve(1024);
-    
     setSize(300, 200); // Ensure minimum size
 }
 
@@ -57,10 +53,13 @@ void ClusterVisualizationComponent::paint(juce::Graphics& g)
         
         // Mode-specific visualization
         const auto mode = static_cast<EngineMode>(audioProcessor.apvts.getRawParameterValue("engine_mode")->load());
-        if (mode == EngineMode::RTEFC)
-            drawRTEFCVisualization(g);
-        else
-            drawKMeansVisualization(g);
+        if (snapshot != nullptr)
+        {
+            if (mode == EngineMode::RTEFC)
+                drawRTEFCVisualization(g, *snapshot);
+            else
+                drawKMeansVisualization(g, *snapshot);
+        }
         
         // Title
         g.setColour(juce::Colours::white);
@@ -98,38 +97,18 @@ void ClusterVisualizationComponent::timerCallback()
         return;
     }
     
-    try
+    // wait-free: just swaps in whatever the audio thread last published
+    const auto mode = static_cast<EngineMode>(audioProcessor.apvts.getRawParameterValue("engine_mode")->load());
+    const bool changed = (mode == EngineMode::RTEFC) ? audioProcessor.getRtefcEngine().acquireVisualization()
+                                                     : audioProcessor.getKMeansEngine().acquireVisualization();
+    const auto* latest = (mode == EngineMode::RTEFC) ? &audioProcessor.getRtefcEngine().getVisualization()
+                                                     : &audioProcessor.getKMeansEngine().getVisualization();
+    
+    if (changed || latest != snapshot)
     {
-        const auto mode = static_cast<EngineMode>(audioProcessor.apvts.getRawParameterValue("engine_mode")->load());
-        
-        if (mode == EngineMode::RTEFC)
-        {
-            cachedCentroids = audioProcessor.rtefcEngine.getVisualizationCentroids();
-            cachedRecentPoints = audioProcessor.rtefcEngine.getRecentPoints();
-            auto currentOpt = audioProcessor.rtefcEngine.getCurrentPoint();
-            hasCurrentPoint = currentOpt.has_value();
-            if (hasCurrentPoint)
-                cachedCurrentPoint = currentOpt.value();
-        }
-        else
-        {
-            cachedCentroids = audioProcessor.kmeansEngine.getVisualizationCentroids();
-            cachedRecentPoints = audioProcessor.kmeansEngine.getWindowPoints();
-            cachedAssignments = audioProcessor.kmeansEngine.getWindowAssignments();
-            auto currentOpt = audioProcessor.kmeansEngine.getCurrentPoint();
-            hasCurrentPoint = currentOpt.has_value();
-            if (hasCurrentPoint)
-                cachedCurrentPoint = currentOpt.value();
-        }
-        
+        snapshot = latest;
         repaint();
     }
-    catch (...)
-    {
-        // Silently handle any engine access errors
-        stopTimer();
-        startTimerHz(10); // Restart at lower frequency
-    }
 }
 
 juce::Point<float> ClusterVisualizationComponent::featureToScreen(const std::array<float,2>& feature) const
@@ -207,9 +186,9 @@ void ClusterVisualizationComponent::drawFeatureAxes(juce::Graphics& g)
     }
 }
 
-void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
+void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g, const VisualizationSnapshot& snap)
 {
-    if (cachedCentroids.empty())
+    if (snap.numCentroids <= 0)
         return;
         
     const float radius = audioProcessor.apvts.getRawParameterValue("radius")->load();
@@ -218,11 +197,11 @@ void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
     // Draw radius circles with bounds checking
     if (autoRadius)
     {
-        const float adaptiveRadius = std::max(radius, 1.25f * audioProcessor.rtefcEngine.getDistanceEMA());
+        const float adaptiveRadius = std::max(radius, 1.25f * snap.distanceEma);
         g.setColour(juce::Colours::yellow.withAlpha(0.3f));
-        for (size_t i = 0; i < cachedCentroids.size(); ++i)
+        for (int i = 0; i < snap.numCentroids; ++i)
         {
-            const auto center = featureToScreen(cachedCentroids[i]);
+            const auto center = featureToScreen(snap.centroids[(size_t) i]);
             const float screenRadius = juce::jlimit(1.0f, 100.0f, adaptiveRadius * getWidth() / (maxX - minX) * 0.15f);
             if (center.x >= 0 && center.y >= 0 && center.x < getWidth() && center.y < getHeight())
             {
@@ -234,9 +213,9 @@ void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
     
     // Draw base radius circles
     g.setColour(juce::Colours::cyan.withAlpha(0.5f));
-    for (size_t i = 0; i < cachedCentroids.size(); ++i)
+    for (int i = 0; i < snap.numCentroids; ++i)
     {
-        const auto center = featureToScreen(cachedCentroids[i]);
+        const auto center = featureToScreen(snap.centroids[(size_t) i]);
         const float screenRadius = juce::jlimit(1.0f, 50.0f, radius * getWidth() / (maxX - minX) * 0.15f);
         if (center.x >= 0 && center.y >= 0 && center.x < getWidth() && center.y < getHeight())
         {
@@ -247,20 +226,20 @@ void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
     
     // Draw recent points with size limit
     g.setColour(juce::Colours::lightgrey.withAlpha(0.6f));
-    const size_t maxPoints = std::min(cachedRecentPoints.size(), size_t(100)); // Limit for performance
-    for (size_t i = 0; i < maxPoints; ++i)
+    const int maxPoints = std::min(snap.numPoints, 100); // Limit for performance
+    for (int i = 0; i < maxPoints; ++i)
     {
-        const auto pos = featureToScreen(cachedRecentPoints[i]);
+        const auto pos = featureToScreen(snap.points[(size_t) i]);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
             g.fillEllipse(pos.x - 2, pos.y - 2, 4, 4);
     }
     
     // Draw centroids with validation
-    for (size_t i = 0; i < cachedCentroids.size() && i < 32; ++i) // Limit clusters drawn
+    for (int i = 0; i < snap.numCentroids && i < 32; ++i) // Limit clusters drawn
     {
-        const auto color = clusterColors[i % clusterColors.size()];
+        const auto color = clusterColors[(size_t) i % clusterColors.size()];
         g.setColour(color);
-        const auto pos = featureToScreen(cachedCentroids[i]);
+        const auto pos = featureToScreen(snap.centroids[(size_t) i]);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
         {
             g.fillEllipse(pos.x - 4, pos.y - 4, 8, 8);
@@ -270,9 +249,9 @@ void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
     }
     
     // Draw current processing point
-    if (hasCurrentPoint)
+    if (snap.hasCurrentPoint)
     {
-        const auto pos = featureToScreen(cachedCurrentPoint);
+        const auto pos = featureToScreen(snap.currentPoint);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
         {
             g.setColour(juce::Colours::white);
@@ -283,31 +262,30 @@ void ClusterVisualizationComponent::drawRTEFCVisualization(juce::Graphics& g)
     }
 }
 
-void ClusterVisualizationComponent::drawKMeansVisualization(juce::Graphics& g)
+void ClusterVisualizationComponent::drawKMeansVisualization(juce::Graphics& g, const VisualizationSnapshot& snap)
 {
-    // Validate data sizes match
-    const size_t maxPoints = std::min({cachedRecentPoints.size(), cachedAssignments.size(), size_t(200)});
+    const int maxPoints = std::min(snap.numPoints, 200);
     
     // Draw window points with cluster assignments
-    for (size_t i = 0; i < maxPoints; ++i)
+    for (int i = 0; i < maxPoints; ++i)
     {
-        const int assignment = cachedAssignments[i];
+        const int assignment = snap.assignments[(size_t) i];
         const auto color = (assignment >= 0 && assignment < (int)clusterColors.size())
                           ? clusterColors[(size_t)assignment].withAlpha(0.7f)
                           : juce::Colours::grey;
         
         g.setColour(color);
-        const auto pos = featureToScreen(cachedRecentPoints[i]);
+        const auto pos = featureToScreen(snap.points[(size_t) i]);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
             g.fillEllipse(pos.x - 3, pos.y - 3, 6, 6);
     }
     
     // Draw centroids with bounds
-    for (size_t i = 0; i < cachedCentroids.size() && i < 32; ++i)
+    for (int i = 0; i < snap.numCentroids && i < 32; ++i)
     {
-        const auto color = clusterColors[i % clusterColors.size()];
+        const auto color = clusterColors[(size_t) i % clusterColors.size()];
         g.setColour(color);
-        const auto pos = featureToScreen(cachedCentroids[i]);
+        const auto pos = featureToScreen(snap.centroids[(size_t) i]);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
         {
             g.fillEllipse(pos.x - 5, pos.y - 5, 10, 10);
@@ -317,14 +295,14 @@ void ClusterVisualizationComponent::drawKMeansVisualization(juce::Graphics& g)
             // Draw cluster number
             g.setColour(juce::Colours::white);
             g.setFont(10.0f);
-            g.drawText(juce::String((int)i), pos.x - 10, pos.y - 15, 20, 12, juce::Justification::centred);
+            g.drawText(juce::String(i), pos.x - 10, pos.y - 15, 20, 12, juce::Justification::centred);
         }
     }
     
     // Draw current processing point
-    if (hasCurrentPoint)
+    if (snap.hasCurrentPoint)
     {
-        const auto pos = featureToScreen(cachedCurrentPoint);
+        const auto pos = featureToScreen(snap.currentPoint);
         if (pos.x >= 0 && pos.y >= 0 && pos.x < getWidth() && pos.y < getHeight())
         {
             g.setColour(juce::Colours::yellow);
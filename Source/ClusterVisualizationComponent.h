@@ -31,8 +31,8 @@ private:
     juce::Point<float> featureToScreen(const std::array<float,2>& feature) const;
     std::array<float,2> screenToFeature(const juce::Point<float>& screen) const;
     
-    void drawRTEFCVisualization(juce::Graphics& g);
-    void drawKMeansVisualization(juce::Graphics& g);
+    void drawRTEFCVisualization(juce::Graphics& g, const VisualizationSnapshot& snap);
+    void drawKMeansVisualization(juce::Graphics& g, const VisualizationSnapshot& snap);
     void drawGrid(juce::Graphics& g);
     void drawFeatureAxes(juce::Graphics& g);
     
@@ -41,12 +41,9 @@ private:
     float minX = -3.0f, maxX = 3.0f;
     float minY = -2.0f, maxY = 2.0f;
     
-    // cache data for smooth updates
-    std::vector<std::array<float,2>> cachedCentroids;
-    std::vector<std::array<float,2>> cachedRecentPoints;
-    std::vector<int> cachedAssignments;
-    std::array<float,2> cachedCurrentPoint = {0.0f, 0.0f};
-    bool hasCurrentPoint = false;
+    // latest snapshot picked up from the active engine; owned by the engine's triple
+    // buffer and stable until our next acquire, so nothing is copied here
+    const VisualizationSnapshot* snapshot = nullptr;
     
     static const std::vector<juce::Colour> clusterColors;
     
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    CommandQueue.h
+    Created: 17 Oct 2026 1:14:37am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+// fixed-size FIFO of small trivially copyable commands, drained by a single consumer
+// thread. hosts call parameter listeners from the message thread, their automation
+// threads and even the audio thread, so producers claim slots with a compare-and-swap
+// rather than a lock: every slot carries a sequence number saying whose turn it is
+// (a bounded multi-producer queue after Vyukov). nobody blocks or allocates; a producer
+// that is preempted between claiming a slot and filling it only holds back the consumer,
+// which picks up from that slot on its next drain
+template <typename T, int capacity>
+class CommandQueue
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "commands are copied in and out by value");
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "positions wrap with a mask");
+    
+    CommandQueue() noexcept
+    {
+        for (size_t i = 0; i < slots.size(); ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
+    // any thread but the consumer; false if the queue is full and the command was dropped
+    bool push(const T& command) noexcept
+    {
+        auto position = writePosition.load(std::memory_order_relaxed);
+        
+        for (;;)
+        {
+            auto& slot = slots[position & mask];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto lag = (std::ptrdiff_t) (sequence - position);
+            
+            if (lag == 0)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.command = command;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+            {
+                return false; // the consumer hasn't got round to this slot since last time
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // consumer: hands every queued command to apply, oldest first
+    template <typename Function>
+    void drain(Function&& apply)
+    {
+        for (;;)
+        {
+            auto& slot = slots[readPosition & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+                return;
+            
+            const T command = slot.command;
+            slot.sequence.store(readPosition + (size_t) capacity, std::memory_order_release);
+            ++readPosition;
+            apply(command);
+        }
+    }
+
+private:
+    static constexpr size_t mask = (size_t) capacity - 1;
+    
+    struct Slot
+    {
+        std::atomic<size_t> sequence { 0 };
+        T command {};
+    };
+    
+    std::array<Slot, (size_t) capacity> slots;
+    std::atomic<size_t> writePosition { 0 };
+    size_t readPosition = 0; // consumer only
+};
@@ -0,0 +1,584 @@
+/*
+  ==============================================================================
+
+    KMeansModel.cpp
+    Created: 16 Oct 2026 3:02:37pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "KMeansModel.h"
+
+void KMeansRefreshJob::allocate(int maxWindowSize)
+{
+    raw.resize((size_t) maxWindowSize);
+    slots.resize((size_t) maxWindowSize);
+    serials.resize((size_t) maxWindowSize);
+    n = 0;
+}
+
+void KMeansModel::allocate(int maxWindowSize, int maxK)
+{
+    clusters.allocate(maxK);
+    featuresNorm.reserve((size_t) maxWindowSize);
+    assignments.reserve((size_t) maxWindowSize);
+}
+
+// ===========================================================
+
+void KMeansRefresher::allocate(int maxWindowSize, int maxK)
+{
+    sum.resize((size_t) maxK);
+    cnt.resize((size_t) maxK);
+    centroidsRaw.resize((size_t) maxK);
+    bestCost.resize((size_t) maxK);
+    
+    prevSerials.resize((size_t) maxWindowSize);
+    prevRaw.resize((size_t) maxWindowSize);
+    prevAssignments.resize((size_t) maxWindowSize);
+    
+    shift.resize((size_t) maxK);
+    upper.resize((size_t) maxWindowSize);
+    lower.resize((size_t) maxWindowSize);
+    seedCost.resize((size_t) maxWindowSize);
+    lowerPerCentre.resize((size_t) maxWindowSize * (size_t) maxK);
+    centreDist.resize((size_t) maxK * (size_t) maxK);
+    halfSeparation.resize((size_t) maxK);
+    reset();
+}
+
+void KMeansRefresher::run(const KMeansRefreshJob& job, KMeansModel& model)
+{
+    begin(job, model);
+    step(std::numeric_limits<juce::int64>::max());
+}
+
+void KMeansRefresher::begin(const KMeansRefreshJob& job, KMeansModel& model)
+{
+    if (isRunning())
+        cancel();
+    
+    const int n = job.n;
+    const int kk = std::min(job.k, n);
+    
+    model.epoch = job.epoch;
+    model.clusters.resize(std::max(0, kk));
+    model.featuresNorm.resize((size_t) std::max(0, n));
+    model.assignments.assign((size_t) std::max(0, n), -1);
+    lastIterations = 0;
+    lastDistances = 0;
+    otherWork = 0;
+    
+    if (n <= 0 || kk <= 0 || n > (int) prevSerials.size() || kk > (int) sum.size())
+    {
+        reset();
+        return;
+    }
+
+    // 1) Normalization stats arrive with the job
+    auto& space = model.clusters;
+    FeatureVector spread;
+    for (size_t d = 0; d < spread.size(); ++d)
+        spread[d] = safeStd(job.stdDev[d]);
+    space.setNormalization(job.mean, spread);
+    space.setAxisWeight(0, job.lengthWeight);
+    
+    // an adaptive metric keeps the previous run's cluster shapes while they still apply
+    if (prevN > 0 && job.epoch == prevEpoch && job.lengthWeight == prevLengthWeight)
+        space.setAxisSpread(prevSpread);
+    else
+        space.resetAxisSpread();
+    
+    currentJob = &job;
+    currentModel = &model;
+    currentK = kk;
+    cursor = 0;
+    phase = Phase::normalize;
+}
+
+void KMeansRefresher::cancel() noexcept
+{
+    phase = Phase::idle;
+    reset();
+}
+
+bool KMeansRefresher::step(juce::int64 maxWork)
+{
+    // at least one unit so every step gets somewhere, without overflowing on "all of it"
+    const auto done = getWorkDone();
+    workLimit = done + juce::jlimit((juce::int64) 1, std::numeric_limits<juce::int64>::max() - done, maxWork);
+    
+    while (phase != Phase::idle && hasWorkLeft())
+    {
+        switch (phase)
+        {
+            case Phase::normalize: stepNormalize(); break;
+            case Phase::slide:     stepSlide(); break;
+            case Phase::seed:      stepSeed(); break;
+            case Phase::assign:    stepAssign(); break;
+            case Phase::finish:    finish(); break;
+            case Phase::idle:
+            default:               break;
+        }
+    }
+    
+    return phase == Phase::idle;
+}
+
+void KMeansRefresher::stepNormalize()
+{
+    // 2) Build normalized features
+    const auto& job = *currentJob;
+    auto& model = *currentModel;
+    for (; cursor < job.n && hasWorkLeft(); ++cursor, ++otherWork)
+        model.featuresNorm[(size_t) cursor] = model.clusters.normalize(job.raw[(size_t) cursor]);
+    
+    if (cursor < job.n)
+        return;
+    
+    // 3) Seed clusters: carry the previous ones over, or initialize from scratch
+    const int evicted = job.warmStart ? findEvictedCount(job, currentK) : -1;
+    if (evicted >= 0)
+    {
+        beginSlide(model, currentK, evicted);
+        cursor = prevN - evicted;
+        phase = Phase::slide;
+    }
+    else
+    {
+        beginColdStart();
+    }
+}
+
+void KMeansRefresher::beginColdStart()
+{
+    const auto& job = *currentJob;
+    auto& model = *currentModel;
+    
+    // farthest-point initialization
+    const int seedIdx = job.n / 2;
+    model.clusters.getCentroids().set(0, model.featuresNorm[(size_t) seedIdx]);
+    centroidsRaw[0] = job.raw[(size_t) seedIdx];
+    
+    // each point's distance to its closest seed so far, so each new seed is O(n)
+    std::fill_n(seedCost.begin(), job.n, std::numeric_limits<float>::max());
+    std::fill_n(sum.begin(), currentK, std::array<double, (size_t) featureDimension> {});
+    std::fill_n(cnt.begin(), currentK, 0);
+    
+    seedIndex = 1;
+    cursor = 0;
+    farIndex = 0;
+    farCost = -1.0f;
+    phase = Phase::seed;
+}
+
+void KMeansRefresher::stepSeed()
+{
+    const auto& job = *currentJob;
+    auto& centroids = currentModel->clusters.getCentroids();
+    const auto& featuresNorm = currentModel->featuresNorm;
+    
+    while (seedIndex < currentK)
+    {
+        for (; cursor < job.n && hasWorkLeft(); ++cursor, ++otherWork)
+        {
+            auto& closest = seedCost[(size_t) cursor];
+            closest = std::min(closest, centroids.cost(seedIndex - 1, featuresNorm[(size_t) cursor]));
+            if (closest > farCost) { farCost = closest; farIndex = cursor; }
+        }
+        
+        if (cursor < job.n)
+            return;
+        
+        centroids.set(seedIndex, featuresNorm[(size_t) farIndex]);
+        centroidsRaw[(size_t) seedIndex] = job.raw[(size_t) farIndex];
+        ++seedIndex;
+        cursor = 0;
+        farIndex = 0;
+        farCost = -1.0f;
+    }
+    
+    converged = false;
+    beginAssignment();
+}
+
+int KMeansRefresher::findEvictedCount(const KMeansRefreshJob& job, int kk) const
+{
+    if (prevN <= 0 || job.epoch != prevEpoch || kk != prevK || job.lengthWeight != prevLengthWeight)
+        return -1;
+    
+    // serials increase through the window, so everything before the job's oldest
+    // serial has been evicted since the last run
+    const auto first = prevSerials.begin();
+    const int evicted = (int) (std::lower_bound(first, first + prevN, job.serials[0]) - first);
+    const int kept = prevN - evicted;
+    
+    if (kept <= 0 || kept > job.n
+        || prevSerials[(size_t) evicted] != job.serials[0]
+        || prevSerials[(size_t) (prevN - 1)] != job.serials[(size_t) (kept - 1)])
+        return -1;
+    
+    return evicted;
+}
+
+void KMeansRefresher::beginSlide(KMeansModel& model, int kk, int evicted)
+{
+    auto& assignments = model.assignments;
+    const int kept = prevN - evicted;
+    
+    for (int i = 0; i < evicted; ++i)
+    {
+        const int a = prevAssignments[(size_t) i];
+        if (a >= 0 && a < kk)
+        {
+            for (size_t d = 0; d < (size_t) featureDimension; ++d)
+                sum[(size_t) a][d] -= prevRaw[(size_t) i][d];
+            cnt[(size_t) a] -= 1;
+        }
+    }
+    
+    std::copy_n(prevAssignments.begin() + evicted, kept, assignments.begin());
+    otherWork += prevN;
+    
+    // previous centroids under this run's normalization
+    updateCentroids(model, kk);
+}
+
+void KMeansRefresher::stepSlide()
+{
+    const auto& job = *currentJob;
+    auto& model = *currentModel;
+    for (; cursor < job.n && hasWorkLeft(); ++cursor)
+        moveTo(job, model, cursor, nearest(model, model.featuresNorm[(size_t) cursor], currentK));
+    
+    if (cursor < job.n)
+        return;
+    
+    converged = updateCentroids(model, currentK) < convergenceTolerance;
+    beginAssignment();
+}
+
+void KMeansRefresher::beginAssignment()
+{
+    currentMethod = assignmentMethod;
+    if (currentMethod == KMeansAssignment::automatic)
+        currentMethod = currentK < elkanMinK ? KMeansAssignment::hamerly : KMeansAssignment::elkan;
+    
+    iteration = 0;
+    passStarted = false;
+    phase = Phase::assign;
+}
+
+void KMeansRefresher::stepAssign()
+{
+    // 4) Lloyd iterations, stopping as soon as no point changes cluster
+    const auto& job = *currentJob;
+    auto& model = *currentModel;
+    const int kk = currentK;
+    
+    while (hasWorkLeft())
+    {
+        if (! passStarted)
+        {
+            if (iteration >= job.iterations || converged)
+            {
+                phase = Phase::finish;
+                return;
+            }
+            
+            if (currentMethod == KMeansAssignment::hamerly || currentMethod == KMeansAssignment::elkan)
+            {
+                updateCentroidSeparation(model, kk, currentMethod == KMeansAssignment::elkan);
+                otherWork += kk;
+            }
+            
+            passStarted = true;
+            passChanges = 0;
+            cursor = 0;
+        }
+        
+        // bounds don't survive a refresh (normalization moves), so rebuild them on the first pass
+        const bool initialise = (iteration == 0);
+        for (; cursor < job.n && hasWorkLeft(); ++cursor, ++otherWork)
+        {
+            bool changed = false;
+            switch (currentMethod)
+            {
+                case KMeansAssignment::hamerly: changed = assignHamerly(job, model, kk, cursor, initialise); break;
+                case KMeansAssignment::elkan:   changed = assignElkan(job, model, kk, cursor, initialise); break;
+                case KMeansAssignment::automatic:
+                case KMeansAssignment::bruteForce:
+                default:                        changed = assignBruteForce(job, model, kk, cursor); break;
+            }
+            
+            if (changed)
+                ++passChanges;
+        }
+        
+        if (cursor < job.n)
+            return;
+        
+        ++lastIterations;
+        updateCentroids(model, kk);
+        converged = (passChanges == 0);
+        
+        if (currentMethod == KMeansAssignment::hamerly)
+            shiftHamerlyBounds(model, kk);
+        else if (currentMethod == KMeansAssignment::elkan)
+            shiftElkanBounds(model, kk);
+        
+        otherWork += job.n;
+        ++iteration;
+        passStarted = false;
+    }
+}
+
+void KMeansRefresher::finish()
+{
+    const auto& job = *currentJob;
+    auto& model = *currentModel;
+    const int n = job.n;
+    
+    // 5) Select representatives
+    selectRepresentatives(job, model, currentK);
+    
+    if constexpr (KMeansModel::Space::adaptiveMetric)
+        measureSpread(model, n);
+    
+    // remember this run for the next warm start
+    prevEpoch = job.epoch;
+    prevK = currentK;
+    prevLengthWeight = job.lengthWeight;
+    prevN = n;
+    std::copy_n(job.serials.begin(), n, prevSerials.begin());
+    std::copy_n(job.raw.begin(), n, prevRaw.begin());
+    std::copy_n(model.assignments.begin(), n, prevAssignments.begin());
+    
+    otherWork += n;
+    currentJob = nullptr;
+    currentModel = nullptr;
+    phase = Phase::idle;
+}
+
+float KMeansRefresher::updateCentroids(KMeansModel& model, int kk)
+{
+    auto& space = model.clusters;
+    float maxShift = 0.0f;
+    for (int ci = 0; ci < kk; ++ci)
+    {
+        // empty clusters stay where they were
+        if (cnt[(size_t) ci] > 0)
+        {
+            for (size_t d = 0; d < (size_t) featureDimension; ++d)
+                centroidsRaw[(size_t) ci][d] = (float)(sum[(size_t) ci][d] / cnt[(size_t) ci]);
+        }
+        
+        const auto c = space.normalize(centroidsRaw[(size_t) ci]);
+        shift[(size_t) ci] = space.distance(c, space.getCentroid(ci));
+        maxShift = std::max(maxShift, shift[(size_t) ci]);
+        space.setCentroid(ci, c);
+    }
+    return maxShift;
+}
+
+int KMeansRefresher::nearest(const KMeansModel& model, const FeatureVector& x, int kk) noexcept
+{
+    jassert(model.clusters.size() == kk);
+    lastDistances += kk;
+    return std::max(0, model.clusters.nearest(x));
+}
+
+bool KMeansRefresher::assignBruteForce(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i)
+{
+    const int best = nearest(model, model.featuresNorm[(size_t) i], kk);
+    if (best == model.assignments[(size_t) i])
+        return false;
+    
+    moveTo(job, model, i, best);
+    return true;
+}
+
+bool KMeansRefresher::assignHamerly(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i, bool initialise)
+{
+    const int a = model.assignments[(size_t) i];
+    if (! initialise && a >= 0)
+    {
+        // nothing can be closer than the own centroid while it is within half the
+        // gap to its neighbour, or within the distance to the second closest
+        const float bound = std::max(halfSeparation[(size_t) a], lower[(size_t) i]);
+        if (upper[(size_t) i] <= bound)
+            return false;
+        
+        upper[(size_t) i] = distance(model, i, a);
+        if (upper[(size_t) i] <= bound)
+            return false;
+    }
+    
+    float c1, c2;
+    const int best = std::max(0, model.clusters.getCentroids().nearestTwo(model.featuresNorm[(size_t) i], c1, c2));
+    lastDistances += kk;
+    upper[(size_t) i] = KMeansModel::Space::costToDistance(c1);
+    lower[(size_t) i] = KMeansModel::Space::costToDistance(c2);
+    
+    if (best == a)
+        return false;
+    
+    moveTo(job, model, i, best);
+    return true;
+}
+
+bool KMeansRefresher::assignElkan(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i, bool initialise)
+{
+    float* lb = lowerPerCentre.data() + (size_t) i * (size_t) kk;
+    const int a = model.assignments[(size_t) i];
+    int best = a;
+    
+    if (initialise || a < 0)
+    {
+        best = 0;
+        upper[(size_t) i] = std::numeric_limits<float>::max();
+        for (int ci = 0; ci < kk; ++ci)
+        {
+            lb[ci] = distance(model, i, ci);
+            if (lb[ci] < upper[(size_t) i]) { upper[(size_t) i] = lb[ci]; best = ci; }
+        }
+    }
+    else if (upper[(size_t) i] > halfSeparation[(size_t) a])
+    {
+        bool upperIsExact = false;
+        for (int ci = 0; ci < kk; ++ci)
+        {
+            if (ci == best)
+                continue;
+            
+            // ci can only win if it beats both its lower bound and half the centroid gap
+            const float bound = std::max(lb[ci], 0.5f * centreDist[(size_t) (best * kk + ci)]);
+            if (upper[(size_t) i] <= bound)
+                continue;
+            
+            if (! upperIsExact)
+            {
+                upper[(size_t) i] = lb[best] = distance(model, i, best);
+                upperIsExact = true;
+                if (upper[(size_t) i] <= bound)
+                    continue;
+            }
+            
+            lb[ci] = distance(model, i, ci);
+            if (lb[ci] < upper[(size_t) i])
+            {
+                upper[(size_t) i] = lb[ci];
+                best = ci;
+            }
+        }
+    }
+    
+    if (best == a)
+        return false;
+    
+    moveTo(job, model, i, best);
+    return true;
+}
+
+void KMeansRefresher::shiftHamerlyBounds(const KMeansModel& model, int kk)
+{
+    // the second closest centroid can have come at most as close as the largest
+    // move among the others
+    int maxIdx = 0;
+    float maxShift = 0.0f, secondShift = 0.0f;
+    for (int ci = 0; ci < kk; ++ci)
+    {
+        const float s = shift[(size_t) ci];
+        if (s > maxShift)         { secondShift = maxShift; maxShift = s; maxIdx = ci; }
+        else if (s > secondShift) { secondShift = s; }
+    }
+    
+    for (int i = 0; i < (int) model.assignments.size(); ++i)
+    {
+        const int a = model.assignments[(size_t) i];
+        upper[(size_t) i] += shift[(size_t) a];
+        lower[(size_t) i] -= (a == maxIdx ? secondShift : maxShift);
+    }
+}
+
+void KMeansRefresher::shiftElkanBounds(const KMeansModel& model, int kk)
+{
+    for (int i = 0; i < (int) model.assignments.size(); ++i)
+    {
+        upper[(size_t) i] += shift[(size_t) model.assignments[(size_t) i]];
+        
+        float* lb = lowerPerCentre.data() + (size_t) i * (size_t) kk;
+        for (int ci = 0; ci < kk; ++ci)
+            lb[ci] = std::max(0.0f, lb[ci] - shift[(size_t) ci]);
+    }
+}
+
+void KMeansRefresher::updateCentroidSeparation(const KMeansModel& model, int kk, bool fullMatrix)
+{
+    const auto& space = model.clusters;
+    std::fill_n(halfSeparation.begin(), kk, std::numeric_limits<float>::max());
+    for (int ci = 0; ci < kk; ++ci)
+    {
+        for (int cj = ci + 1; cj < kk; ++cj)
+        {
+            const float half = 0.5f * space.distance(space.getCentroid(ci), space.getCentroid(cj));
+            halfSeparation[(size_t) ci] = std::min(halfSeparation[(size_t) ci], half);
+            halfSeparation[(size_t) cj] = std::min(halfSeparation[(size_t) cj], half);
+            
+            if (fullMatrix)
+                centreDist[(size_t) (ci * kk + cj)] = centreDist[(size_t) (cj * kk + ci)] = 2.0f * half;
+        }
+    }
+}
+
+void KMeansRefresher::moveTo(const KMeansRefreshJob& job, KMeansModel& model, int point, int cluster)
+{
+    const auto& x = job.raw[(size_t) point];
+    auto& a = model.assignments[(size_t) point];
+    
+    if (a >= 0)
+    {
+        for (size_t d = 0; d < (size_t) featureDimension; ++d)
+            sum[(size_t) a][d] -= x[d];
+        cnt[(size_t) a] -= 1;
+    }
+    
+    a = cluster;
+    for (size_t d = 0; d < (size_t) featureDimension; ++d)
+        sum[(size_t) a][d] += x[d];
+    cnt[(size_t) a] += 1;
+}
+
+void KMeansRefresher::selectRepresentatives(const KMeansRefreshJob& job, KMeansModel& model, int kk)
+{
+    // one pass: the point closest to its own centroid represents the cluster
+    std::fill_n(bestCost.begin(), kk, std::numeric_limits<float>::max());
+    for (int i = 0; i < job.n; ++i)
+    {
+        const int ci = model.assignments[(size_t) i];
+        if (ci < 0 || ci >= kk) continue;
+        const float c = model.clusters.getCentroids().cost(ci, model.featuresNorm[(size_t) i]);
+        if (c < bestCost[(size_t) ci])
+        {
+            bestCost[(size_t) ci] = c;
+            model.clusters.setRepresentative(ci, { job.slots[(size_t) i], job.serials[(size_t) i] });
+        }
+    }
+}
+
+void KMeansRefresher::measureSpread(const KMeansModel& model, int n)
+{
+    std::array<double, (size_t) featureDimension> residual {};
+    for (int i = 0; i < n; ++i)
+    {
+        const auto& x = model.featuresNorm[(size_t) i];
+        const auto c = model.clusters.getCentroid(model.assignments[(size_t) i]);
+        for (size_t d = 0; d < residual.size(); ++d)
+            residual[d] += juce::square((double) (x[d] - c[d]));
+    }
+    
+    // residuals are in weighted units, the space wants them before the weights
+    for (size_t d = 0; d < residual.size(); ++d)
+        prevSpread[d] = (float) (residual[d] / n) / juce::square(model.clusters.getAxisWeight((int) d));
+}
@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    KMeansModel.h
+    Created: 16 Oct 2026 3:02:37pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ClusterSpace.h"
+#include "WavesetFeatures.h"
+#include <vector>
+#include <array>
+#include <limits>
+
+// snapshot of the window handed from the audio thread to the refresh worker
+struct KMeansRefreshJob
+{
+    juce::uint32 epoch = 0; // engine reset counter, stale results are dropped
+    int k = 8;
+    int iterations = 3;
+    float lengthWeight = 5.0f;
+    bool warmStart = true; // seed from the previous model when the window just slid along
+    
+    // window normalization per feature, maintained incrementally by the engine
+    FeatureVector mean {}, stdDev {};
+    
+    // one entry per waveset in the window, oldest first
+    int n = 0;
+    std::vector<FeatureVector> raw;    // WavesetFeatures, unnormalized
+    std::vector<int> slots;            // ring slot the entry lives in
+    std::vector<juce::uint32> serials; // detects the slot being reused later
+    
+    void allocate(int maxWindowSize);
+};
+
+// the metric k-means clusters with. the bounded assignments rely on the triangle
+// inequality, which all of ClusterMetrics.h satisfy
+using KMeansMetric = WeightedEuclidean;
+
+// result of one refresh: normalization, centroids and one representative per cluster
+struct KMeansModel
+{
+    struct Representative
+    {
+        int slot = -1;
+        juce::uint32 serial = 0;
+    };
+    
+    using Space = ClusterSpace<featureDimension, KMeansMetric, Representative>;
+    
+    juce::uint32 epoch = 0;
+    
+    Space clusters; // normalization, centroids and representatives
+    
+    // normalized window and its assignments, kept for visualization
+    std::vector<FeatureVector> featuresNorm;
+    std::vector<int> assignments;
+    
+    void allocate(int maxWindowSize, int maxK);
+};
+
+// how Lloyd iterations find each point's nearest centroid. the bounded methods keep
+// triangle-inequality bounds per point and skip most distance evaluations once
+// the centroids settle; they reach the same assignments as the brute-force scan
+enum class KMeansAssignment
+{
+    automatic, // currently Hamerly, see elkanMinK
+    bruteForce,
+    hamerly,   // one upper and one lower bound per point
+    elkan      // one upper and k lower bounds per point
+};
+
+// runs the k-means refresh; owns its scratch space so repeated runs don't allocate.
+// in warm-start mode it keeps the previous run's clusters (as raw-feature sums) and
+// only moves the points that left or entered the window, then refines until no
+// assignment changes, so the cost follows how much the window changed.
+// a refresh is a resumable state machine (normalize, seed, assign/update passes,
+// representatives), so it can also be spread over many short slices
+class KMeansRefresher
+{
+public:
+    void allocate(int maxWindowSize, int maxK);
+    
+    // forget the previous run; the next one starts cold
+    void reset() noexcept { prevN = 0; }
+    
+    // compute mean/std, normalize, run k-means, pick reps
+    void run(const KMeansRefreshJob& job, KMeansModel& model);
+    
+    // the same refresh in slices: begin() takes the job, which must stay untouched
+    // until the refresh completes, and each step() does about maxWork units of work
+    // (point-centroid evaluations) and returns true once the model is complete.
+    // every step makes some progress
+    void begin(const KMeansRefreshJob& job, KMeansModel& model);
+    bool step(juce::int64 maxWork);
+    bool isRunning() const noexcept { return phase != Phase::idle; }
+    
+    // abandons the refresh in progress, leaving its model half written. the
+    // running sums are then out of step, so the next refresh starts cold
+    void cancel() noexcept;
+    
+    // work done by the current (or last) refresh, in the units step() budgets
+    juce::int64 getWorkDone() const noexcept { return lastDistances + otherWork; }
+    
+    void setAssignmentMethod(KMeansAssignment m) noexcept { assignmentMethod = m; }
+    
+    // iterations actually run by the last refresh (early exit on convergence)
+    int getLastIterationCount() const noexcept { return lastIterations; }
+    
+    // point-centroid distances evaluated by the last refresh's Lloyd iterations
+    juce::int64 getLastDistanceCount() const noexcept { return lastDistances; }
+    
+private:
+    static inline float safeStd(float s) { return s < 1e-6f ? 1.0f : s; }
+    
+    // centroid moves below this (in normalized units) count as converged
+    static constexpr float convergenceTolerance = 1.0e-3f;
+    
+    // Elkan's k lower bounds per point only pay for themselves with many centroids
+    // and costly distances; with a handful of features Hamerly wins at every k we allow
+    static constexpr int elkanMinK = std::numeric_limits<int>::max();
+    
+    enum class Phase
+    {
+        idle,
+        normalize, // build normalized features
+        slide,     // warm start: assign the points that entered the window
+        seed,      // cold start: farthest-point seeding, one centroid per sweep
+        assign,    // Lloyd passes, each followed by a centroid update
+        finish     // representatives, spread, remember the run
+    };
+    
+    // refresh in progress; the job and model belong to the caller
+    Phase phase = Phase::idle;
+    const KMeansRefreshJob* currentJob = nullptr;
+    KMeansModel* currentModel = nullptr;
+    int currentK = 0;
+    KMeansAssignment currentMethod = KMeansAssignment::bruteForce;
+    int cursor = 0;         // next point the current phase looks at
+    int seedIndex = 0;      // seed: centroid being placed
+    int farIndex = 0;       // seed: farthest point so far
+    float farCost = -1.0f;
+    int iteration = 0;      // assign: current pass
+    int passChanges = 0;
+    bool passStarted = false;
+    bool converged = false;
+    
+    juce::int64 otherWork = 0; // points visited outside distance evaluations
+    juce::int64 workLimit = 0; // end of the current step
+    bool hasWorkLeft() const noexcept { return getWorkDone() < workLimit; }
+    
+    // each advances its phase until it is done or the step's work runs out
+    void stepNormalize();
+    void stepSlide();
+    void stepSeed();
+    void stepAssign();
+    void finish();
+    
+    void beginColdStart();
+    void beginAssignment();
+    
+    // number of leading previous points that have since left the window, or -1 if
+    // the previous run can't be reused for this job
+    int findEvictedCount(const KMeansRefreshJob& job, int kk) const;
+    
+    // drops evicted points and keeps the survivors' assignments; stepSlide() then
+    // assigns the new ones
+    void beginSlide(KMeansModel& model, int kk, int evicted);
+    
+    // rebuilds normalized centroids from the sums, returns the largest move; the
+    // move of each centroid is left in shift
+    float updateCentroids(KMeansModel& model, int kk);
+    
+    // assigns one point during a pass, returns whether it changed cluster. the bounded
+    // methods start from exact bounds when initialise is set
+    bool assignBruteForce(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i);
+    bool assignHamerly(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i, bool initialise);
+    bool assignElkan(const KMeansRefreshJob& job, KMeansModel& model, int kk, int i, bool initialise);
+    
+    // loosen the bounds by how far the centroids just moved
+    void shiftHamerlyBounds(const KMeansModel& model, int kk);
+    void shiftElkanBounds(const KMeansModel& model, int kk);
+    
+    // centroid-centroid distances and half the distance to each centroid's nearest neighbour
+    void updateCentroidSeparation(const KMeansModel& model, int kk, bool fullMatrix);
+    
+    float distance(const KMeansModel& model, int point, int cluster) noexcept
+    {
+        ++lastDistances;
+        return model.clusters.distance(model.featuresNorm[(size_t) point], model.clusters.getCentroid(cluster));
+    }
+    
+    int nearest(const KMeansModel& model, const FeatureVector& x, int kk) noexcept;
+    void moveTo(const KMeansRefreshJob& job, KMeansModel& model, int point, int cluster);
+    void selectRepresentatives(const KMeansRefreshJob& job, KMeansModel& model, int kk);
+    
+    // within-cluster variance per axis, for adaptive metrics
+    void measureSpread(const KMeansModel& model, int n);
+    
+    // per-cluster running sums in raw feature space; normalization is affine, so the
+    // normalized centroid is just the normalized raw mean
+    std::vector<std::array<double, (size_t) featureDimension>> sum;
+    std::vector<int> cnt;
+    std::vector<FeatureVector> centroidsRaw;
+    std::vector<float> bestCost;
+    std::vector<float> seedCost;
+    std::vector<float> shift;
+    
+    // triangle-inequality bounds, in metric distance
+    KMeansAssignment assignmentMethod = KMeansAssignment::automatic;
+    std::vector<float> upper;          // per point, to its own centroid
+    std::vector<float> lower;          // Hamerly: per point, to the second closest centroid
+    std::vector<float> lowerPerCentre; // Elkan: per point and centroid, n x k
+    std::vector<float> centreDist;     // Elkan: k x k
+    std::vector<float> halfSeparation; // per centroid
+    
+    // previous run, for warm starts
+    juce::uint32 prevEpoch = 0;
+    int prevK = 0;
+    float prevLengthWeight = 0.0f;
+    int prevN = 0;
+    std::vector<juce::uint32> prevSerials;
+    std::vector<FeatureVector> prevRaw;
+    std::vector<int> prevAssignments;
+    FeatureVector prevSpread {};
+    
+    int lastIterations = 0;
+    juce::int64 lastDistances = 0;
+};
@@ -9,29 +9,64 @@
 */
 
 #include "KMeansWindowEngine.h"
+#include "RealtimeGuard.h"
 
-KMeansWindowEngine::KMeansWindowEngine() {}
+KMeansWindowEngine::KMeansWindowEngine()
+{
+    // every buffer is sized for the largest window up front; nothing is in the pool yet
+    jobs.forEachBuffer([] (KMeansRefreshJob& j) { j.allocate(maxWindowSize); });
+    models.forEachBuffer([] (KMeansModel& m) { m.allocate(maxWindowSize, maxK); });
+    refresher.allocate(maxWindowSize, maxK);
+    ring.allocate(maxWindowSize);
+}
+
+KMeansWindowEngine::~KMeansWindowEngine()
+{
+    workerPool->remove(refreshClient);
+}
 
-void KMeansWindowEngine::prepare(double sr)
+void KMeansWindowEngine::prepare(double sr, bool renderingOffline, int numChannels)
 {
+    // take the refreshes back from the pool before touching anything they share with us
+    refreshInline = renderingOffline;
+    if (refreshInline)
+    {
+        workerPool->remove(refreshClient);
+        refresher.cancel();
+        refreshOwner.store(workerOwns);
+    }
+    
     sampleRate = sr;
+    
+    // the pool only has to hold the audio that is actually in the window, plus
+    // room for the longest waveset the processor can hand us
+    maxWavesetLength = std::max(1, (int) std::round(sampleRate * 2.0));
+    const int poolSize = std::max(maxWavesetLength, (int) std::round(sampleRate * poolSeconds));
+    pool.setSize(juce::jlimit(1, WavesetHandle::maxChannels, numChannels), poolSize, false, false, true);
+    pool.clear();
+    
     resetAll();
+    
+    if (! refreshInline)
+        workerPool->add(refreshClient, WorkerPool::Priority::normal);
 }
 
 
 void KMeansWindowEngine::resetAll()
 {
-    ring.clear();
     ringWriteIndex = 0;
     countInWindow = 0;
+    rebuildStats();
+    poolWritePosition = 0;
+    ++storageGeneration;
     
-    centroids.clear();
-    representatives.clear();
-    
-    featuresNorm.clear();
-    assignments.clear();
+    // models computed before this point belong to a window that no longer exists
+    ++epoch;
+    activeModel = nullptr;
+    if (isRefreshingSliced())
+        refresher.cancel();
     
-    lastChosen.setSize(0, 0);
+    lastChosen = {};
     
     wavesetsSinceRefresh = 0;
     
@@ -39,21 +74,29 @@ void KMeansWindowEngine::resetAll()
 }
 
 
-void KMeansWindowEngine::setParameters(int kClusters, int windowSizeWavesets, int refreshIntervalWavesets, int iterationsPerRefresh, float lengthWeightParam)
+void KMeansWindowEngine::setParameters(int kClusters, int windowSizeWavesets, int refreshIntervalWavesets, int iterationsPerRefresh, float lengthWeightParam, bool warmStart)
 {
-    pending.k.store(juce::jlimit(2, 48, kClusters));
-    pending.windowSize.store(juce::jlimit(64, 1024, windowSizeWavesets));
+    pending.k.store(juce::jlimit(2, maxK, kClusters));
+    pending.windowSize.store(juce::jlimit(64, maxWindowSize, windowSizeWavesets));
     pending.refreshInterval.store(juce::jlimit(1, 128, refreshIntervalWavesets));
     pending.iterations.store(juce::jlimit(1, 8, iterationsPerRefresh));
     pending.lengthWeight.store(juce::jlimit(0.1f, 24.0f, lengthWeightParam));
+    pending.warmStart.store(warmStart);
     
     pending.hasChanges.store(true);
 }
 
+void KMeansWindowEngine::setRefreshBudget(float microsecondsPerBlock)
+{
+    refreshBudgetSeconds = juce::jmax(0.0, (double) microsecondsPerBlock * 1.0e-6);
+}
+
 void KMeansWindowEngine::applyPendingParams()
 {
     if (!pending.hasChanges.load())
         return;
+    
+    RTWAVESETS_REALTIME_SITE("KMeansWindowEngine::applyPendingParams");
         
     // Apply all changes atomically on audio thread
     currentK = pending.k.load();
@@ -61,352 +104,403 @@ void KMeansWindowEngine::applyPendingParams()
     currentRefreshInterval = pending.refreshInterval.load();
     currentIterations = pending.iterations.load();
     currentLengthWeight = pending.lengthWeight.load();
+    currentWarmStart = pending.warmStart.load();
     
-    // Resize data structures safely
-    countInWindow = std::min(countInWindow, currentWindowSize);
-    
-    // Resize ring buffer
-    if ((int)ring.size() != currentWindowSize)
-    {
-        const int maxLen = (int) std::round(sampleRate * 2.0);
-        std::vector<Entry> newRing((size_t) currentWindowSize);
-        
-        const int toCopy = std::min(currentWindowSize, (int)ring.size());
-        for (int i = 0; i < currentWindowSize; ++i)
-        {
-            auto& e = newRing[(size_t) i];
-            e.audio.setSize(2, maxLen, false, false, true);
-            e.audio.clear();
-            
-            if (i < toCopy && i < (int)ring.size())
-            {
-                e.length = ring[(size_t) i].length;
-                e.rms = ring[(size_t) i].rms;
-                const int copyLen = std::min(maxLen, ring[(size_t) i].audio.getNumSamples());
-                for (int ch = 0; ch < 2; ++ch)
-                    e.audio.copyFrom(ch, 0, ring[(size_t) i].audio, ch, 0, copyLen);
-            }
-            else
-            {
-                e.length = 0;
-                e.rms = 0.0f;
-            }
-        }
-        ring.swap(newRing);
-        
-        ringWriteIndex = juce::jlimit(0, std::max(0, currentWindowSize - 1), ringWriteIndex);
-        countInWindow = std::min(countInWindow, currentWindowSize);
-    }
-    
-    // Resize working arrays
-    featuresNorm.resize((size_t) currentWindowSize);
-    assignments.resize((size_t) currentWindowSize);
-    
-    // Resize cluster arrays - critical for the crash fix
-    const int kk = std::min(currentK, std::max(1, countInWindow));
-    centroids.resize((size_t) kk);
-    representatives.assign((size_t) kk, -1);
+    // Resize ring; k, iterations and weight go out with the next refresh job
+    ensureWindowCapacity();
     
     pending.hasChanges.store(false);
 }
 
-const juce::AudioBuffer<float>& KMeansWindowEngine::processWaveset(const juce::AudioBuffer<float>& newWaveset)
+WavesetHandle KMeansWindowEngine::processWaveset(const juce::AudioBuffer<float>& newWaveset)
 {
+    RTWAVESETS_REALTIME_SITE("KMeansWindowEngine::processWaveset");
     applyPendingParams();
+    adoptLatestModel();
         
     if (newWaveset.getNumSamples() <= 0 || newWaveset.getNumChannels() <= 0)
         return lastChosen;
 
     auto raw = extractFeatures(newWaveset);
     lastProcessedFeatures = normalizeFeature(raw);
-    writeEntry(newWaveset, raw);
+    const bool written = writeEntry(newWaveset, raw);
 
+    // a refresh that isn't taken (a sliced one is still running) is retried per waveset
     wavesetsSinceRefresh++;
-    if (wavesetsSinceRefresh >= currentRefreshInterval)
-    {
-        refreshModel();
+    if (wavesetsSinceRefresh >= currentRefreshInterval && submitRefresh())
         wavesetsSinceRefresh = 0;
-    }
 
+    // play straight out of the pool: the chosen representative, or the new waveset itself
     const int repIdx = quantizeIndexFor(raw);
-    if (repIdx >= 0 && repIdx < (int)ring.size() && repIdx < countInWindow)
+    if (isSlotInWindow(repIdx))
+        lastChosen = makeHandle(repIdx);
+    else if (written)
+        lastChosen = makeHandle(windowSlot(countInWindow - 1));
+    else
+        lastChosen = {};
+
+    return lastChosen;
+}
+
+bool KMeansWindowEngine::submitRefresh()
+{
+    const int n = countInWindow;
+    if (n <= 0)
+        return false;
+    
+    // a sliced refresh reads the job buffer until it completes
+    const bool sliced = ! refreshInline && isRefreshingSliced();
+    if (sliced && refresher.isRunning())
+        return false;
+    
+    RTWAVESETS_REALTIME_SITE("KMeansWindowEngine::submitRefresh");
+    
+    // O(window) copy of a few numbers per entry; the heavy lifting happens on the worker
+    auto& job = jobs.getWriteBuffer();
+    job.epoch = epoch;
+    job.k = currentK;
+    job.iterations = currentIterations;
+    job.lengthWeight = currentLengthWeight;
+    job.warmStart = currentWarmStart;
+    job.n = n;
+    
+    // normalization comes straight from the running stats
+    for (size_t d = 0; d < stats.size(); ++d)
     {
-        const auto& src = ring[(size_t) repIdx].audio;
-        lastChosen.setSize(src.getNumChannels(), src.getNumSamples(), false, false, true);
-        for (int ch = 0; ch < src.getNumChannels(); ++ch)
-            lastChosen.copyFrom(ch, 0, src, ch, 0, src.getNumSamples());
+        job.mean[d] = (float) stats[d].getMean();
+        job.stdDev[d] = (float) std::sqrt(std::max(1e-12, stats[d].getVariance()));
     }
-    else
+    
+    for (int i = 0; i < n; ++i)
     {
-        lastChosen.makeCopyOf(newWaveset);
+        const int slot = windowSlot(i);
+        for (size_t d = 0; d < ring.features.size(); ++d)
+            job.raw[(size_t) i][d] = ring.features[d][(size_t) slot];
+        job.slots[(size_t) i] = slot;
+        job.serials[(size_t) i] = ring.serial[(size_t) slot];
     }
-
-    return lastChosen;
+    
+    if (refreshInline)
+    {
+        // the client is out of the pool, so we are the only producer of models
+        refresher.run(job, models.getWriteBuffer());
+        models.publish();
+        adoptLatestModel();
+        return true;
+    }
+    
+    if (sliced)
+    {
+        // the job stays in our write buffer; advanceRefresh() works through it
+        refresher.begin(job, models.getWriteBuffer());
+        return true;
+    }
+    
+    jobs.publish();
+    return true;
 }
 
-std::array<float,2> KMeansWindowEngine::extractFeatures(const juce::AudioBuffer<float> &waveset)
+bool KMeansWindowEngine::isRefreshingSliced() const noexcept
 {
-    const int len = waveset.getNumSamples();
-    const float rms = waveset.getRMSLevel(0, 0, len);
-    return { (float) len, rms };
+    return refreshBudgetSeconds > 0.0 && refreshOwner.load(std::memory_order_acquire) == audioOwns;
 }
 
-void KMeansWindowEngine::ensureWindowCapacity()
+void KMeansWindowEngine::advanceRefresh()
 {
-    const int target = currentWindowSize;
-    if ((int)ring.size() != target)
+    if (refreshInline)
+        return;
+    
+    if (refreshBudgetSeconds <= 0.0)
     {
-        const int maxLen = (int) std::round(sampleRate * 2.0);
-        const int numCh = 2;
-
-        std::vector<Entry> newRing((size_t) target);
-        const int toCopy = std::min(target, (int)ring.size());
-        for (int i = 0; i < target; ++i)
+        // give the refresher back; whatever was half done is dropped
+        if (refreshOwner.load(std::memory_order_relaxed) != workerOwns)
         {
-            auto& e = newRing[(size_t) i];
-            e.audio.setSize(numCh, maxLen, false, false, true);
-            e.audio.clear();
-            if (i < toCopy)
-            {
-                e.length = ring[(size_t) i].length;
-                e.rms = ring[(size_t) i].rms;
-                const int copyLen = std::min(maxLen, ring[(size_t) i].audio.getNumSamples());
-                const int chs = std::min(numCh, ring[(size_t) i].audio.getNumChannels());
-                for (int ch = 0; ch < chs; ++ch)
-                    e.audio.copyFrom(ch, 0, ring[(size_t) i].audio, ch, 0, copyLen);
-            }
-            else
-            {
-                e.length = 0;
-                e.rms = 0.0f;
-            }
+            if (refreshOwner.load(std::memory_order_acquire) == audioOwns)
+                refresher.cancel();
+            refreshOwner.store(workerOwns, std::memory_order_release);
         }
-        ring.swap(newRing);
+        return;
+    }
+    
+    if (refreshOwner.load(std::memory_order_relaxed) == workerOwns)
+        refreshOwner.store(handingToAudio, std::memory_order_release);
+    
+    // until the worker has finished its current job, refreshes keep going to it
+    if (! isRefreshingSliced() || ! refresher.isRunning())
+        return;
+    
+    RTWAVESETS_REALTIME_SITE("KMeansWindowEngine::advanceRefresh");
+    
+    const auto maxWork = std::max(minRefreshSliceWork, (juce::int64) (refreshBudgetSeconds / secondsPerRefreshWork));
+    const auto workBefore = refresher.getWorkDone();
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    const bool complete = refresher.step(maxWork);
+    const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    
+    // a slice that ran over (cache misses, preemption) shrinks the next ones right away,
+    // one that came in under lets them grow back slowly
+    const auto work = refresher.getWorkDone() - workBefore;
+    if (work > 0)
+    {
+        const double perWork = elapsed / (double) work;
+        secondsPerRefreshWork += (perWork > secondsPerRefreshWork ? 0.5 : 0.05) * (perWork - secondsPerRefreshWork);
+        secondsPerRefreshWork = juce::jlimit(1.0e-10, 1.0e-5, secondsPerRefreshWork);
+    }
+    
+    if (complete)
+    {
+        models.publish();
+        adoptLatestModel();
+    }
+}
 
-        ringWriteIndex = juce::jlimit(0, std::max(0, target - 1), ringWriteIndex);
-        countInWindow = std::min(countInWindow, target);
+void KMeansWindowEngine::adoptLatestModel()
+{
+    if (! models.acquire())
+        return;
+    
+    const auto& model = models.getReadBuffer();
+    activeModel = (model.epoch == epoch) ? &model : nullptr;
+}
 
-        for (auto& ridx : representatives)
+bool KMeansWindowEngine::RefreshClient::service()
+{
+    auto owner = engine.refreshOwner.load(std::memory_order_acquire);
+    if (owner == audioOwns)
+        return false;
+    
+    if (! engine.refresher.isRunning())
+    {
+        // the audio thread wants to refresh in slices: hand over between jobs and idle
+        if (owner == handingToAudio)
         {
-            if (ridx < 0 || ridx >= target)
-                ridx = -1;
+            engine.refreshOwner.compare_exchange_strong(owner, audioOwns, std::memory_order_acq_rel);
+            return false;
         }
+        
+        if (! engine.jobs.acquire())
+            return false;
+        
+        engine.refresher.begin(engine.jobs.getReadBuffer(), engine.models.getWriteBuffer());
     }
-
-    if ((int)featuresNorm.size() != target) featuresNorm.resize((size_t) target);
-    if ((int)assignments.size() != target) assignments.resize((size_t) target);
+    
+    if (engine.refresher.step(refreshSliceWork))
+        engine.models.publish();
+    
+    return true;
 }
 
-void KMeansWindowEngine::writeEntry(const juce::AudioBuffer<float>& ws, const std::array<float,2>& raw)
+WavesetHandle KMeansWindowEngine::makeHandle(int slot) const
 {
-    ensureWindowCapacity();
-
-    Entry& e = ring[(size_t) ringWriteIndex];
-    e.length = (int) raw[0];
-    e.rms = raw[1];
-
-    const int copyLen = std::min(e.audio.getNumSamples(), ws.getNumSamples());
-    const int chs = std::min(e.audio.getNumChannels(), ws.getNumChannels());
-    e.audio.clear();
-    for (int ch = 0; ch < chs; ++ch)
-        e.audio.copyFrom(ch, 0, ws, ch, 0, copyLen);
-
-    ringWriteIndex = (ringWriteIndex + 1) % std::max(1, currentWindowSize);
-    countInWindow = std::min(countInWindow + 1, currentWindowSize);
+    WavesetHandle h;
+    h.numChannels = std::min(pool.getNumChannels(), WavesetHandle::maxChannels);
+    for (int ch = 0; ch < h.numChannels; ++ch)
+        h.channels[ch] = pool.getReadPointer(ch, ring.offset[(size_t) slot]);
+    h.numSamples = ring.numSamples[(size_t) slot];
+    h.generation = storageGeneration.load();
+    return h;
 }
 
-void KMeansWindowEngine::computeWindowStats(float& muLen, float& sdLen, float& muRms, float& sdRms) const
+FeatureVector KMeansWindowEngine::extractFeatures(const juce::AudioBuffer<float> &waveset)
 {
-    const int n = countInWindow;
-    if (n <= 0)
-    {
-        muLen = 0; sdLen = 1; muRms = 0; sdRms = 1;
-        return;
-    }
-
-    double sLen = 0, sRms = 0;
-    for (int i = 0; i < n; ++i)
-    {
-        const auto& e = ring[(size_t) i];
-        sLen += e.length;
-        sRms += e.rms;
-    }
-    muLen = (float)(sLen / n);
-    muRms = (float)(sRms / n);
+    return WavesetFeatures::select(WavesetAnalyser::analyse(waveset));
+}
 
-    double vLen = 0, vRms = 0;
-    for (int i = 0; i < n; ++i)
+void KMeansWindowEngine::ensureWindowCapacity()
+{
+    const int target = currentWindowSize;
+    if (ring.size() != target)
     {
-        const auto& e = ring[(size_t) i];
-        const double dl = e.length - muLen;
-        const double dr = e.rms - muRms;
-        vLen += dl * dl;
-        vRms += dr * dr;
+        // the columns hold maxWindowSize entries from the start, so this only changes the
+        // ring's logical size. entries are just offsets into the pool: the newest ones
+        // that still fit are rotated in place to slots 0.., oldest first
+        const int keep = std::min(countInWindow, target);
+        if (keep > 0)
+            ring.rotateToFront(windowSlot(countInWindow - keep), ring.size());
+        ring.logicalSize = target;
+
+        countInWindow = keep;
+        ringWriteIndex = keep % std::max(1, target);
+        rebuildStats();
+
+        // representatives that pointed at moved slots fail their serial check from now on
     }
-    sdLen = safeStd((float) std::sqrt(std::max(1e-12, vLen / n)));
-    sdRms = safeStd((float) std::sqrt(std::max(1e-12, vRms / n)));
 }
 
-std::array<float,2> KMeansWindowEngine::normalizeFeature(const std::array<float,2>& raw) const
+int KMeansWindowEngine::windowSlot(int i) const noexcept
 {
-    float x0 = (raw[0] - meanLen) / stdLen;
-    float x1 = (raw[1] - meanRms) / stdRms;
+    const int size = std::max(1, ring.size());
+    return ((ringWriteIndex - countInWindow + i) % size + size) % size;
+}
 
-    x0 *= currentLengthWeight;
-    return { x0, x1 };
+bool KMeansWindowEngine::isSlotInWindow(int slot) const noexcept
+{
+    const int size = ring.size();
+    if (slot < 0 || slot >= size)
+        return false;
+    
+    // age relative to the oldest entry
+    const int age = ((slot - windowSlot(0)) % size + size) % size;
+    return age < countInWindow;
 }
 
-int KMeansWindowEngine::nearestCentroid(const std::array<float,2>& x) const
+void KMeansWindowEngine::evictOldest()
 {
-    if (centroids.empty()) return -1;
-    int best = -1;
-    float bestD2 = std::numeric_limits<float>::max();
-    for (int i = 0; i < (int)centroids.size(); ++i)
+    if (countInWindow > 0)
     {
-        const float d2 = distance2(x, centroids[(size_t) i]);
-        if (d2 < bestD2) { bestD2 = d2; best = i; }
+        const auto slot = (size_t) windowSlot(0);
+        for (size_t d = 0; d < stats.size(); ++d)
+            stats[d].remove(ring.features[d][slot]);
+        
+        // its audio is about to be overwritten, so outstanding handles may go stale
+        --countInWindow;
+        ++storageGeneration;
+        
+        // removals drift slowly; resync once per window's worth so it stays amortized O(1)
+        if (++removalsSinceStatsRebuild >= std::max(64, ring.size()))
+            rebuildStats();
     }
-    return best;
 }
 
-float KMeansWindowEngine::distance2(const std::array<float,2>& a, const std::array<float,2>& b) const
+void KMeansWindowEngine::rebuildStats()
 {
-    const float dx = a[0] - b[0];
-    const float dy = a[1] - b[1];
-    return dx*dx + dy*dy;
+    for (auto& s : stats)
+        s.clear();
+    
+    for (int i = 0; i < countInWindow; ++i)
+    {
+        const auto slot = (size_t) windowSlot(i);
+        for (size_t d = 0; d < stats.size(); ++d)
+            stats[d].add(ring.features[d][slot]);
+    }
+    removalsSinceStatsRebuild = 0;
 }
 
-int KMeansWindowEngine::quantizeIndexFor(const std::array<float,2>& raw) const
+void KMeansWindowEngine::WindowColumns::allocate(int maxSize)
 {
-    const int n = countInWindow;
-    if (centroids.empty() || n <= 0) return -1;
-
-    std::array<float,2> x = normalizeFeature(raw);
-    const int cidx = nearestCentroid(x);
-    if (cidx < 0 || cidx >= (int)representatives.size()) return -1;
-
-    const int repRingIdx = representatives[(size_t) cidx];
-    if (repRingIdx < 0 || repRingIdx >= n) return -1;
-    return repRingIdx;
+    for (auto& column : features)
+        column.assign((size_t) maxSize, 0.0f);
+    offset.assign((size_t) maxSize, 0);
+    numSamples.assign((size_t) maxSize, 0);
+    serial.assign((size_t) maxSize, 0);
+    logicalSize = 0;
 }
 
-void KMeansWindowEngine::refreshModel()
+void KMeansWindowEngine::WindowColumns::rotateToFront(int first, int ringSize) noexcept
 {
-    const int n = countInWindow;
-    if (n <= 0) return;
+    auto rotate = [=] (auto& column) { std::rotate(column.begin(), column.begin() + first, column.begin() + ringSize); };
+    for (auto& column : features)
+        rotate(column);
+    rotate(offset);
+    rotate(numSamples);
+    rotate(serial);
+}
 
-    const int kk = std::min(currentK, n);
-    if (kk <= 0) return;
-    
-    // Ensure arrays match current parameters
-    if ((int)centroids.size() != kk) centroids.resize((size_t) kk);
-    if ((int)representatives.size() != kk) representatives.assign((size_t) kk, -1);
+bool KMeansWindowEngine::writeEntry(const juce::AudioBuffer<float>& ws, const FeatureVector& raw)
+{
+    ensureWindowCapacity();
 
-    // 1) Compute normalization stats
-    computeWindowStats(meanLen, stdLen, meanRms, stdRms);
+    const int size = ring.size();
+    const int length = std::min(ws.getNumSamples(), maxWavesetLength);
+    if (size <= 0 || length <= 0 || length > pool.getNumSamples())
+        return false;
 
-    // 2) Build normalized features
-    for (int i = 0; i < n; ++i)
-        featuresNorm[(size_t) i] = normalizeFeature({ (float) ring[(size_t) i].length, ring[(size_t) i].rms });
+    // window full: the slot we are about to reuse holds the oldest entry
+    if (countInWindow >= size)
+        evictOldest();
 
-    // 3) Initialize centroids
-    centroids[0] = featuresNorm[(size_t)(n / 2)];
-    for (int ci = 1; ci < kk; ++ci)
+    int start = poolWritePosition;
+    if (start + length > pool.getNumSamples())
     {
-        int farIdx = 0;
-        float farDist = -1.0f;
-        for (int i = 0; i < n; ++i)
-        {
-            float d2min = std::numeric_limits<float>::max();
-            for (int cj = 0; cj < ci; ++cj)
-                d2min = std::min(d2min, distance2(featuresNorm[(size_t) i], centroids[(size_t) cj]));
-            if (d2min > farDist) { farDist = d2min; farIdx = i; }
-        }
-        centroids[(size_t) ci] = featuresNorm[(size_t) farIdx];
+        // no room before the end of the pool; whatever still lives in the tail
+        // is older than everything at the front, so drop it and wrap around
+        while (countInWindow > 0 && ring.offset[(size_t) windowSlot(0)] >= start)
+            evictOldest();
+        start = 0;
     }
 
-    // 4) Lloyd iterations
-    for (int it = 0; it < currentIterations; ++it)
+    // drop the oldest entries whose audio we are about to overwrite
+    while (countInWindow > 0)
     {
-        // Assign each point to nearest centroid
-        for (int i = 0; i < n; ++i)
-        {
-            int best = 0;
-            float bestD2 = std::numeric_limits<float>::max();
-            for (int ci = 0; ci < kk; ++ci)
-            {
-                const float d2 = distance2(featuresNorm[(size_t) i], centroids[(size_t) ci]);
-                if (d2 < bestD2) { bestD2 = d2; best = ci; }
-            }
-            assignments[(size_t) i] = best;
-        }
-
-        // Update centroids
-        std::vector<std::array<double,2>> sum((size_t) kk, {0.0, 0.0});
-        std::vector<int> cnt((size_t) kk, 0);
-        for (int i = 0; i < n; ++i)
-        {
-            const int a = assignments[(size_t) i];
-            if (a >= 0 && a < kk) // Defensive bounds check
-            {
-                const auto& x = featuresNorm[(size_t) i];
-                sum[(size_t) a][0] += x[0];
-                sum[(size_t) a][1] += x[1];
-                cnt[(size_t) a] += 1;
-            }
-        }
-        for (int ci = 0; ci < kk; ++ci)
-        {
-            if (cnt[(size_t) ci] > 0)
-            {
-                centroids[(size_t) ci][0] = (float)(sum[(size_t) ci][0] / cnt[(size_t) ci]);
-                centroids[(size_t) ci][1] = (float)(sum[(size_t) ci][1] / cnt[(size_t) ci]);
-            }
-        }
+        const auto oldest = (size_t) windowSlot(0);
+        const int oldestOffset = ring.offset[oldest];
+        if (oldestOffset >= start + length || oldestOffset + ring.numSamples[oldest] <= start)
+            break;
+        evictOldest();
     }
 
-    // 5) Select representatives
-    for (int ci = 0; ci < kk; ++ci)
-    {
-        int bestIdx = -1;
-        float bestD2 = std::numeric_limits<float>::max();
-        for (int i = 0; i < n; ++i)
-        {
-            if (assignments[(size_t) i] != ci) continue;
-            const float d2 = distance2(featuresNorm[(size_t) i], centroids[(size_t) ci]);
-            if (d2 < bestD2) { bestD2 = d2; bestIdx = i; }
-        }
-        representatives[(size_t) ci] = (bestIdx >= 0 && bestIdx < n) ? bestIdx : -1;
-    }
+    for (int ch = 0; ch < pool.getNumChannels(); ++ch)
+        pool.copyFrom(ch, start, ws, std::min(ch, ws.getNumChannels() - 1), 0, length);
+
+    const auto slot = (size_t) ringWriteIndex;
+    // the stored length is what the pool actually holds
+    ring.features[0][slot] = (float) length;
+    for (size_t d = 1; d < ring.features.size(); ++d)
+        ring.features[d][slot] = raw[d];
+    ring.offset[slot] = start;
+    ring.numSamples[slot] = length;
+    ring.serial[slot] = nextSerial++;
+    for (size_t d = 0; d < stats.size(); ++d)
+        stats[d].add(ring.features[d][slot]);
+    poolWritePosition = start + length;
+
+    ringWriteIndex = (ringWriteIndex + 1) % size;
+    countInWindow = std::min(countInWindow + 1, size);
+    return true;
 }
 
-std::vector<std::array<float,2>> KMeansWindowEngine::getVisualizationCentroids() const
+FeatureVector KMeansWindowEngine::normalizeFeature(const FeatureVector& raw) const
 {
-    return centroids;
+    if (activeModel != nullptr)
+        return activeModel->clusters.normalize(raw);
+    
+    // no model yet: identity stats, current weight
+    auto x = raw;
+    x[0] *= currentLengthWeight;
+    return x;
 }
 
-std::vector<std::array<float,2>> KMeansWindowEngine::getWindowPoints() const
+int KMeansWindowEngine::quantizeIndexFor(const FeatureVector& raw) const
 {
-    std::vector<std::array<float,2>> points;
-    const int n = std::min(countInWindow, (int)featuresNorm.size());
-    points.reserve((size_t)n);
-    for (int i = 0; i < n; ++i)
-        points.push_back(featuresNorm[(size_t)i]);
-    return points;
-}
+    if (activeModel == nullptr || countInWindow <= 0) return -1;
 
-std::vector<int> KMeansWindowEngine::getWindowAssignments() const
-{
-    std::vector<int> assigns;
-    const int n = std::min(countInWindow, (int)assignments.size());
-    assigns.reserve((size_t)n);
-    for (int i = 0; i < n; ++i)
-        assigns.push_back(assignments[(size_t)i]);
-    return assigns;
+    const auto& clusters = activeModel->clusters;
+    const int cidx = clusters.nearest(clusters.normalize(raw));
+    if (cidx < 0 || cidx >= clusters.size()) return -1;
+
+    // the model may be a few wavesets old; make sure its pick still holds that waveset
+    const auto& rep = clusters.getRepresentative(cidx);
+    if (! isSlotInWindow(rep.slot) || ring.serial[(size_t) rep.slot] != rep.serial) return -1;
+    return rep.slot;
 }
 
-std::optional<std::array<float,2>> KMeansWindowEngine::getCurrentPoint() const
+void KMeansWindowEngine::publishVisualization()
 {
-    return lastProcessedFeatures;
+    RTWAVESETS_REALTIME_SITE("KMeansWindowEngine::publishVisualization");
+    auto& snap = visualization.getWriteBuffer();
+    
+    snap.numCentroids = 0;
+    snap.numPoints = 0;
+    if (activeModel != nullptr)
+    {
+        snap.numCentroids = std::min(activeModel->clusters.size(), VisualizationSnapshot::maxCentroids);
+        for (int i = 0; i < snap.numCentroids; ++i)
+            snap.centroids[(size_t) i] = VisualizationSnapshot::project(activeModel->clusters.getCentroid(i));
+        
+        const int n = (int) std::min(activeModel->featuresNorm.size(), activeModel->assignments.size());
+        snap.numPoints = std::min(n, VisualizationSnapshot::maxPoints);
+        for (int i = 0; i < snap.numPoints; ++i)
+            snap.points[(size_t) i] = VisualizationSnapshot::project(activeModel->featuresNorm[(size_t) i]);
+        std::copy_n(activeModel->assignments.begin(), snap.numPoints, snap.assignments.begin());
+    }
+    
+    snap.hasCurrentPoint = lastProcessedFeatures.has_value();
+    if (snap.hasCurrentPoint)
+        snap.currentPoint = VisualizationSnapshot::project(*lastProcessedFeatures);
+    
+    snap.distanceEma = 0.0f;
+    visualization.publish();
+    
+    publishedNumClusters.store(snap.numCentroids);
+    publishedWindowCount.store(countInWindow);
 }
-
@@ -11,6 +11,12 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "WavesetHandle.h"
+#include "TripleBuffer.h"
+#include "VisualizationSnapshot.h"
+#include "KMeansModel.h"
+#include "RunningStats.h"
+#include "WorkerPool.h"
 #include <vector>
 #include <array>
 #include <atomic>
@@ -20,41 +26,92 @@ class KMeansWindowEngine
 {
 public:
     KMeansWindowEngine();
+    ~KMeansWindowEngine();
     
-    void prepare(double sampleRate);
+    // offline, refreshes run inline on the processing thread instead of the worker,
+    // so a render doesn't outrun its own clustering and comes out the same every time.
+    // numChannels of waveset storage, 1 or 2 (channel groups of the processor)
+    void prepare(double sampleRate, bool renderingOffline = false, int numChannels = WavesetHandle::maxChannels);
     
     void resetAll();
     
-    // parameters (set from processor)
+    // parameters (set from the processor on the audio thread; applied with the next waveset)
     void setParameters(int kClusters,
                        int windowSizeWavesets,
                        int refreshIntervalWavesets,
                        int iterationsPerRefresh,
-                       float lengthWeight);
+                       float lengthWeight,
+                       bool warmStart);
     
-    // called per completed waveset; returns a representative buffer
-    const juce::AudioBuffer<float>& processWaveset(const juce::AudioBuffer<float>& newWaveset);
+    // the thread calling processWaveset, which while playing is the channel group's
+    // analysis slice on the worker pool, not the audio thread: 0 leaves refreshes to
+    // their own pool client; above that the analysis takes them over and spends about
+    // this long per block on them, so a refresh never holds up one block's analysis
+    // by more than the budget
+    void setRefreshBudget(float microsecondsPerBlock);
     
-    int getNumClusters() const noexcept { return (int) centroids.size(); }
-    int getWindowCount() const noexcept { return countInWindow; }
+    // called per completed waveset; returns a handle to a representative in the pool
+    WavesetHandle processWaveset(const juce::AudioBuffer<float>& newWaveset);
     
-    std::vector<std::array<float,2>> getVisualizationCentroids() const;
-    std::vector<std::array<float,2>> getWindowPoints() const;
-    std::vector<int> getWindowAssignments() const;
-    std::optional<std::array<float,2>> getCurrentPoint() const;
+    // processWaveset's thread, once per block: advances a sliced refresh within the budget and
+    // adopts the model once it is complete
+    void advanceRefresh();
+    
+    // bumped whenever pool audio that a handle may point at is overwritten or discarded
+    juce::uint32 getStorageGeneration() const noexcept { return storageGeneration.load(); }
+    
+    // telemetry, safe from any thread (updated when visualization is published)
+    int getNumClusters() const noexcept { return publishedNumClusters.load(); }
+    int getWindowCount() const noexcept { return publishedWindowCount.load(); }
+    
+    // audio thread: copies the current state into the snapshot channel
+    void publishVisualization();
+    
+    // message thread (single reader): picks up the newest snapshot, false if nothing changed
+    bool acquireVisualization() noexcept { return visualization.acquire(); }
+    const VisualizationSnapshot& getVisualization() const noexcept { return visualization.getReadBuffer(); }
     
 private:
-    struct Entry
+    static constexpr int maxK = 128;
+    static constexpr int maxWindowSize = 4096;
+    
+    // ring buffer for window data, one column per field indexed by ring slot. the
+    // refresh and the running stats only walk the feature columns, which stay
+    // small and contiguous instead of being interleaved with pool bookkeeping
+    struct WindowColumns
     {
-        int length = 0;
-        float rms = 0.0f;
-        juce::AudioBuffer<float> audio;
+        std::array<std::vector<float>, (size_t) featureDimension> features; // one column per feature
+        std::vector<int> offset;   // start of this waveset's audio in the sample pool
+        std::vector<int> numSamples;
+        std::vector<juce::uint32> serial; // unique per written waveset
+        
+        // the columns are allocated once for the largest window; the ring only uses
+        // the first logicalSize slots, so the window can change size on the audio thread
+        int logicalSize = 0;
+        int size() const noexcept { return logicalSize; }
+        void allocate(int maxSize);
+        
+        // moves the entries in slots [first, ringSize) and [0, first) to the front, in place
+        void rotateToFront(int first, int ringSize) noexcept;
     };
     
-    // ring buffer for window data
-    std::vector<Entry> ring; // size = windowSize
+    WindowColumns ring; // size = windowSize
     int ringWriteIndex = 0;
-    int countInWindow = 0; // number of valid entries [0..windowSize]
+    int countInWindow = 0; // number of valid entries [0..windowSize], oldest first
+    juce::uint32 nextSerial = 1;
+    
+    // contiguous circular sample storage shared by every ring entry; the oldest
+    // entries are evicted when their audio gets overwritten
+    static constexpr double poolSeconds = 8.0;
+    juce::AudioBuffer<float> pool;
+    int poolWritePosition = 0;
+    int maxWavesetLength = 0;
+    std::atomic<juce::uint32> storageGeneration { 1 };
+    
+    // window normalization, kept up to date as entries come and go
+    std::array<RunningStats, (size_t) featureDimension> stats;
+    int removalsSinceStatsRebuild = 0;
+    void rebuildStats();
     
     struct PendingParams
     {
@@ -64,6 +121,7 @@ private:
         std::atomic<int> refreshInterval { 32 };
         std::atomic<int> iterations { 3 };
         std::atomic<float> lengthWeight { 5.0f };
+        std::atomic<bool> warmStart { true };
     };
     
     PendingParams pending;
@@ -72,40 +130,78 @@ private:
     int currentRefreshInterval = 32;
     int currentIterations = 3;
     float currentLengthWeight = 5.0f;
+    bool currentWarmStart = true;
     
     // Apply pending parameter changes safely (audio thread only)
     void applyPendingParams();
     
     int wavesetsSinceRefresh = 0;
     
-    std::vector<std::array<float,2>> centroids;
-    std::vector<int> representatives; // index into ring
+    // k-means runs on the shared worker pool: the audio thread publishes window
+    // snapshots into jobs, the worker publishes finished models back, and the audio
+    // thread only does nearest-centroid lookups against the newest model. the worker
+    // goes through a job in slices of refreshSliceWork, so other instances' jobs get
+    // their turns in between
+    class RefreshClient : public WorkerPool::Client
+    {
+    public:
+        explicit RefreshClient(KMeansWindowEngine& e) : engine(e) {}
+        bool service() override;
+        
+    private:
+        KMeansWindowEngine& engine;
+    };
+    
+    static constexpr juce::int64 refreshSliceWork = 1 << 18;
+    bool refreshInline = false; // set in prepare(), while the client is out of the pool
+    
+    TripleBuffer<KMeansRefreshJob> jobs;
+    TripleBuffer<KMeansModel> models;
+    KMeansRefresher refresher; // refresh owner only, see refreshOwner
+    juce::SharedResourcePointer<WorkerPool> workerPool;
+    RefreshClient refreshClient { *this };
     
-    juce::AudioBuffer<float> lastChosen;
+    // who may use refresher and produce models. the audio thread asks for them by
+    // moving workerOwns -> handingToAudio, the worker hands them over between jobs
+    // (handingToAudio -> audioOwns), and the audio thread gives them back by storing
+    // workerOwns. refreshing inline ignores this, the client is out of the pool then
+    enum RefreshOwner { workerOwns, handingToAudio, audioOwns };
+    std::atomic<int> refreshOwner { workerOwns };
+    bool isRefreshingSliced() const noexcept;
     
-    float meanLen = 0.0f, stdLen = 1.0f;
-    float meanRms = 0.0f, stdRms = 1.0f;
+    // sliced refreshes (processWaveset's thread only): the budget is turned into an amount of
+    // refresher work using a running estimate of how long one unit takes
+    double refreshBudgetSeconds = 0.0;
+    double secondsPerRefreshWork = 5.0e-9;
+    static constexpr juce::int64 minRefreshSliceWork = 256;
     
-    std::vector<std::array<float,2>> featuresNorm;
-    std::vector<int> assignments;
+    const KMeansModel* activeModel = nullptr; // audio thread only; models' read buffer
+    juce::uint32 epoch = 1;                   // bumped on reset so in-flight refreshes are dropped
     
-    double sampleRate;
+    WavesetHandle lastChosen;
     
-    static std::array<float,2> extractFeatures(const juce::AudioBuffer<float>& waveset);
+    double sampleRate = 44100.0;
+    
+    static FeatureVector extractFeatures(const juce::AudioBuffer<float>& waveset);
     void ensureWindowCapacity();
-    void writeEntry(const juce::AudioBuffer<float>& ws, const std::array<float,2>& raw);
+    bool writeEntry(const juce::AudioBuffer<float>& ws, const FeatureVector& raw);
     
-    void refreshModel(); // compute mean/std, normalize, run k-means, pick reps
+    // ring slot of the i-th oldest entry in the window
+    int windowSlot(int i) const noexcept;
+    bool isSlotInWindow(int slot) const noexcept;
+    void evictOldest();
+    WavesetHandle makeHandle(int slot) const;
     
-    void computeWindowStats(float& muLen, float& sdLen, float& muRms, float& sdRms) const;
-    std::array<float,2> normalizeFeature(const std::array<float,2>& raw) const;
+    bool submitRefresh(); // snapshot the window for the worker, false if it wasn't taken
+    void adoptLatestModel();
     
-    int nearestCentroid(const std::array<float,2>& x) const;
-    float distance2(const std::array<float,2>& a, const std::array<float,2>& b) const;
-
-    int quantizeIndexFor(const std::array<float,2>& raw) const;
+    FeatureVector normalizeFeature(const FeatureVector& raw) const;
 
-    static inline float safeStd(float s) { return s < 1e-6f ? 1.0f : s; }
+    int quantizeIndexFor(const FeatureVector& raw) const;
+    
+    std::optional<FeatureVector> lastProcessedFeatures;
     
-    std::optional<std::array<float,2>> lastProcessedFeatures;
+    TripleBuffer<VisualizationSnapshot> visualization;
+    std::atomic<int> publishedNumClusters { 0 };
+    std::atomic<int> publishedWindowCount { 0 };
 };
@@ -0,0 +1,123 @@
+/*
+  ==============================================================================
+
+    LoadHistogram.h
+    Created: 17 Oct 2026 12:31:06am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+// processing cost per block as a fraction of the block's deadline (1 = the block took as
+// long as it lasts). values are added with relaxed atomics and never wait, from one
+// thread or from several at once (every channel group adds its engine loads); any other
+// thread can read the counts at any time. bins are 1% wide, the last one catches
+// everything from 200% up
+class LoadHistogram
+{
+public:
+    static constexpr int numBins = 201;
+    using Counts = std::array<juce::uint32, (size_t) numBins>;
+    
+    // audio thread or engine side
+    void add(float load) noexcept
+    {
+        const int bin = juce::jlimit(0, numBins - 1, (int) (load * 100.0f));
+        bins[(size_t) bin].fetch_add(1, std::memory_order_relaxed);
+        
+        latest.store(load, std::memory_order_relaxed);
+        auto previousPeak = peak.load(std::memory_order_relaxed);
+        while (load > previousPeak)
+            if (peak.compare_exchange_weak(previousPeak, load, std::memory_order_relaxed))
+                break;
+    }
+    
+    // while nothing is adding, e.g. from prepareToPlay
+    void reset() noexcept
+    {
+        for (auto& b : bins)
+            b.store(0, std::memory_order_relaxed);
+        latest.store(0.0f);
+        peak.store(0.0f);
+    }
+    
+    float getLatest() const noexcept { return latest.load(std::memory_order_relaxed); }
+    float getPeak() const noexcept   { return peak.load(std::memory_order_relaxed); }
+    
+    // totals since the last reset; they only grow, so two reads a while apart give the
+    // distribution in between
+    void read(Counts& dest) const noexcept
+    {
+        for (size_t i = 0; i < dest.size(); ++i)
+            dest[i] = bins[i].load(std::memory_order_relaxed);
+    }
+    
+    // upper edge of the bin holding the p-th fraction of the values, 0 if there are none
+    static float percentile(const Counts& counts, float p) noexcept
+    {
+        juce::uint64 total = 0;
+        for (auto c : counts)
+            total += c;
+        if (total == 0)
+            return 0.0f;
+        
+        const auto rank = (juce::uint64) std::ceil((double) p * (double) total);
+        juce::uint64 seen = 0;
+        for (int i = 0; i < numBins; ++i)
+        {
+            seen += counts[(size_t) i];
+            if (seen >= rank)
+                return (float) (i + 1) / 100.0f;
+        }
+        return (float) numBins / 100.0f;
+    }
+
+private:
+    std::array<std::atomic<juce::uint32>, (size_t) numBins> bins {};
+    std::atomic<float> latest { 0.0f }, peak { 0.0f };
+};
+
+// the last few seconds of a LoadHistogram, for a display polling it at a steady rate
+class LoadHistogramWindow
+{
+public:
+    explicit LoadHistogramWindow(int numPolls) : history((size_t) juce::jmax(1, numPolls)) {}
+    
+    // reads the histogram; percentiles then cover the values added over the last numPolls calls
+    void poll(const LoadHistogram& histogram) noexcept
+    {
+        histogram.read(newest);
+        
+        // the histogram was reset underneath us: start over from here
+        const auto& previous = history[(size_t) ((oldest + (int) history.size() - 1) % (int) history.size())];
+        for (size_t i = 0; i < newest.size(); ++i)
+        {
+            if (newest[i] < previous[i])
+            {
+                for (auto& h : history)
+                    h = newest;
+                break;
+            }
+        }
+        
+        for (size_t i = 0; i < newest.size(); ++i)
+            recent[i] = newest[i] - history[(size_t) oldest][i];
+        
+        history[(size_t) oldest] = newest;
+        oldest = (oldest + 1) % (int) history.size();
+    }
+    
+    float getPercentile(float p) const noexcept { return LoadHistogram::percentile(recent, p); }
+
+private:
+    std::vector<LoadHistogram::Counts> history;
+    LoadHistogram::Counts newest {}, recent {};
+    int oldest = 0;
+};
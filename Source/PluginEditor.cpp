@@ -23,6 +23,21 @@ RTWavesetsAudioProcessorEditor::RTWavesetsAudioProcessorEditor (RTWavesetsAudioP
     modeLabel.setText("Engine Mode", juce::dontSendNotification);
     addAndMakeVisible(modeLabel);
     
+    channelLinkCombo.addItem("Pairs", 1);
+    channelLinkCombo.addItem("Independent", 2);
+    addAndMakeVisible(channelLinkCombo);
+    channelLinkAtt = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (audioProcessor.apvts, "channel_link", channelLinkCombo);
+    channelLinkLabel.setText("Channels", juce::dontSendNotification);
+    addAndMakeVisible(channelLinkLabel);
+    
+    viewedChannelsCombo.onChange = [this]()
+    {
+        if (viewedChannelsCombo.getSelectedId() > 0)
+            audioProcessor.setVisualizedGroup(viewedChannelsCombo.getSelectedId() - 1);
+    };
+    addAndMakeVisible(viewedChannelsCombo);
+    updateViewedChannels();
+    
     auto configureSlider = [] (juce::Slider& s)
     {
         s.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
@@ -57,21 +72,38 @@ RTWavesetsAudioProcessorEditor::RTWavesetsAudioProcessorEditor (RTWavesetsAudioP
         addAndMakeVisible(l);
     }
     
-    for (auto* s : { &kmKSlider,&kmWindowSlider,&kmRefreshSlider,&kmItersSlider,&kmLenWeightSlider })
+    for (auto* s : { &kmKSlider,&kmWindowSlider,&kmRefreshSlider,&kmItersSlider,&kmLenWeightSlider,&kmRefreshBudgetSlider })
         configureSlider(*s);
     addAndMakeVisible(kmKSlider);
     addAndMakeVisible(kmWindowSlider);
     addAndMakeVisible(kmRefreshSlider);
     addAndMakeVisible(kmItersSlider);
     addAndMakeVisible(kmLenWeightSlider);
+    addAndMakeVisible(kmRefreshBudgetSlider);
+    addAndMakeVisible(kmWarmStartToggle);
 
     kmKLabel.setText("K (clusters)", juce::dontSendNotification);
     kmWindowLabel.setText("Window (wavesets)", juce::dontSendNotification);
     kmRefreshLabel.setText("Refresh Interval", juce::dontSendNotification);
     kmItersLabel.setText("Iterations/Refresh", juce::dontSendNotification);
     kmLenWeightLabel.setText("KMeans Length Weight", juce::dontSendNotification);
+    kmRefreshBudgetLabel.setText("Refresh Slice (us)", juce::dontSendNotification);
     
-    for (auto* l : { &kmKLabel, &kmWindowLabel, &kmRefreshLabel, &kmItersLabel, &kmLenWeightLabel })
+    for (auto* l : { &kmKLabel, &kmWindowLabel, &kmRefreshLabel, &kmItersLabel, &kmLenWeightLabel, &kmRefreshBudgetLabel })
+    {
+        l->setJustificationType(juce::Justification::centred);
+        addAndMakeVisible(l);
+    }
+    
+    configureSlider(zcHysteresisSlider);
+    configureSlider(zcMinLengthSlider);
+    addAndMakeVisible(zcHysteresisSlider);
+    addAndMakeVisible(zcMinLengthSlider);
+    
+    zcHysteresisLabel.setText("crossing hysteresis", juce::dontSendNotification);
+    zcMinLengthLabel.setText("min waveset length", juce::dontSendNotification);
+    
+    for (auto* l : { &zcHysteresisLabel, &zcMinLengthLabel })
     {
         l->setJustificationType(juce::Justification::centred);
         addAndMakeVisible(l);
@@ -98,10 +130,17 @@ RTWavesetsAudioProcessorEditor::RTWavesetsAudioProcessorEditor (RTWavesetsAudioP
     addAndMakeVisible(distanceLabel);
     addAndMakeVisible(windowCountLabel);
     
+    for (auto* l : { &blockLoadLabel, &rtefcLoadLabel, &kmeansLoadLabel, &qualityLabel, &qualityLogLabel })
+    {
+        l->setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain));
+        addAndMakeVisible(l);
+    }
+    qualityLogLabel.setJustificationType(juce::Justification::topLeft);
+    
     visualizationComponent = std::make_unique<ClusterVisualizationComponent>(audioProcessor);
     addAndMakeVisible(visualizationComponent.get());
     
-    setSize (900, 460);
+    setSize (900, 860);
     
     startTimerHz(10);
 }
@@ -130,12 +169,17 @@ void RTWavesetsAudioProcessorEditor::resized()
     
     auto controlsArea = r.removeFromLeft((int)(r.getWidth() * 0.6f));
         
-    visualizationComponent->setBounds(r.reduced(5));
+    auto plotArea = r.reduced(5);
+    viewedChannelsCombo.setBounds(plotArea.removeFromTop(30).reduced(0, 3).removeFromLeft(160));
+    visualizationComponent->setBounds(plotArea);
     
     // Layout controls in the left area (existing code but using controlsArea instead of r)
     auto top = controlsArea.removeFromTop(40);
-    modeLabel.setBounds(top.removeFromLeft(120));
-    engineModeCombo.setBounds(top.removeFromLeft(200));
+    modeLabel.setBounds(top.removeFromLeft(100));
+    engineModeCombo.setBounds(top.removeFromLeft(140));
+    top.removeFromLeft(20);
+    channelLinkLabel.setBounds(top.removeFromLeft(70));
+    channelLinkCombo.setBounds(top.removeFromLeft(140));
 
     // RTEFC row
     auto row1 = controlsArea.removeFromTop(150);
@@ -180,7 +224,7 @@ void RTWavesetsAudioProcessorEditor::resized()
 
     // KMeans row
     auto row3 = controlsArea.removeFromTop(150);
-    colW = row3.getWidth() / 5;
+    colW = row3.getWidth() / 6;
     {
         auto b = row3.removeFromLeft(colW).reduced(6);
         kmKLabel.setBounds(b.removeFromTop(18));
@@ -206,17 +250,133 @@ void RTWavesetsAudioProcessorEditor::resized()
         kmLenWeightLabel.setBounds(b.removeFromTop(18));
         kmLenWeightSlider.setBounds(b);
     }
+    {
+        auto b = row3.removeFromLeft(colW).reduced(6);
+        kmRefreshBudgetLabel.setBounds(b.removeFromTop(18));
+        kmRefreshBudgetSlider.setBounds(b);
+    }
+    kmWarmStartToggle.setBounds(controlsArea.removeFromTop(30).reduced(6, 3).removeFromLeft(300));
+    
+    // segmentation row
+    auto row4 = controlsArea.removeFromTop(150);
+    colW = row4.getWidth() / 3;
+    {
+        auto b = row4.removeFromLeft(colW).reduced(6);
+        zcHysteresisLabel.setBounds(b.removeFromTop(18));
+        zcHysteresisSlider.setBounds(b);
+    }
+    {
+        auto b = row4.removeFromLeft(colW).reduced(6);
+        zcMinLengthLabel.setBounds(b.removeFromTop(18));
+        zcMinLengthSlider.setBounds(b);
+    }
 
     // Telemetry
-    auto bottom = controlsArea.removeFromTop(40);
+    auto bottom = controlsArea.removeFromTop(30);
     clustersLabel.setBounds(bottom.removeFromLeft(200));
     distanceLabel.setBounds(bottom.removeFromLeft(220));
     windowCountLabel.setBounds(bottom.removeFromLeft(200));
+    
+    for (auto* l : { &blockLoadLabel, &rtefcLoadLabel, &kmeansLoadLabel, &qualityLabel })
+        l->setBounds(controlsArea.removeFromTop(20));
+    qualityLogLabel.setBounds(controlsArea.removeFromTop(18 * qualityLogLines));
 }
 
 void RTWavesetsAudioProcessorEditor::timerCallback()
 {
-    clustersLabel.setText("clusters: " + juce::String(audioProcessor.rtefcEngine.getNumClusters()), juce::dontSendNotification);
-    distanceLabel.setText("mean d: " + juce::String(audioProcessor.rtefcEngine.getDistanceEMA(), 2), juce::dontSendNotification);
-    windowCountLabel.setText("Windowed count: " + juce::String(audioProcessor.kmeansEngine.getWindowCount()), juce::dontSendNotification);
+    updateViewedChannels();
+    
+    // the processor only acts on a reset going up; put it back down so the next press counts
+    for (auto* id : { "reset_clusters", "reset_all" })
+        if (auto* p = audioProcessor.apvts.getParameter(id))
+            if (p->getValue() > 0.5f)
+                p->setValueNotifyingHost(0.0f);
+    
+    clustersLabel.setText("clusters: " + juce::String(audioProcessor.getRtefcEngine().getNumClusters()), juce::dontSendNotification);
+    distanceLabel.setText("mean d: " + juce::String(audioProcessor.getRtefcEngine().getDistanceEMA(), 2), juce::dontSendNotification);
+    windowCountLabel.setText("Windowed count: " + juce::String(audioProcessor.getKMeansEngine().getWindowCount()), juce::dontSendNotification);
+    
+    blockLoadWindow.poll(audioProcessor.blockLoad);
+    rtefcLoadWindow.poll(audioProcessor.rtefcLoad);
+    kmeansLoadWindow.poll(audioProcessor.kmeansLoad);
+    
+    const bool kmeansActive = audioProcessor.apvts.getRawParameterValue("engine_mode")->load() > 0.5f;
+    auto describeLoad = [] (const juce::String& name, const LoadHistogram& h, const LoadHistogramWindow& w, bool active)
+    {
+        auto percent = [] (float load) { return (juce::String(juce::roundToInt(load * 100.0f)) + "%").paddedLeft(' ', 5); };
+        return name.paddedRight(' ', 10)
+             + (active ? "now " + percent(h.getLatest()) : juce::String("now     -"))
+             + "   p99 " + percent(w.getPercentile(0.99f))
+             + "   peak " + percent(h.getPeak());
+    };
+    
+    blockLoadLabel.setText(describeLoad("block", audioProcessor.blockLoad, blockLoadWindow, true), juce::dontSendNotification);
+    rtefcLoadLabel.setText(describeLoad("RTEFC", audioProcessor.rtefcLoad, rtefcLoadWindow, ! kmeansActive), juce::dontSendNotification);
+    kmeansLoadLabel.setText(describeLoad("K-Means", audioProcessor.kmeansLoad, kmeansLoadWindow, kmeansActive), juce::dontSendNotification);
+    
+    // adjustments may have waited in the queue while no editor was open, so each one
+    // is stamped with when it happened rather than when it is shown
+    const auto now = juce::Time::getCurrentTime();
+    const auto nowMs = juce::Time::getMillisecondCounter();
+    audioProcessor.qualityAdjustments.drain([this, now, nowMs] (const QualityGovernor::Adjustment& a)
+    {
+        const auto happened = now - juce::RelativeTime::milliseconds((juce::int64) (nowMs - a.timeMs));
+        const auto time = happened.toString(false, true, true, true);
+        const auto line = a.toLevel > a.fromLevel
+                            ? time + "  load " + juce::String(juce::roundToInt(a.load * 100.0f)) + "%, quality down to " + juce::String(a.toLevel)
+                            : time + "  quality back up to " + juce::String(a.toLevel);
+        qualityLog.insert(0, line);
+        qualityLog.removeRange(qualityLogLines, qualityLog.size());
+    });
+    
+    const bool governorOn = audioProcessor.apvts.getRawParameterValue("quality_governor")->load() > 0.5f;
+    qualityLabel.setText(governorOn ? describeQuality(audioProcessor.governor.getLevel()) : juce::String("quality   adaptive quality off"),
+                         juce::dontSendNotification);
+    qualityLogLabel.setText(qualityLog.joinIntoString("\n"), juce::dontSendNotification);
+}
+
+juce::String RTWavesetsAudioProcessorEditor::describeQuality(int level) const
+{
+    if (level == 0)
+        return "quality   full";
+    
+    // only the settings the governor actually moved
+    const auto requested = audioProcessor.getRequestedQuality();
+    const auto effective = QualityGovernor::apply(requested, level);
+    juce::StringArray changes;
+    auto note = [&changes] (const juce::String& name, float from, float to)
+    {
+        if (juce::roundToInt(from) != juce::roundToInt(to))
+            changes.add(name + " " + juce::String(juce::roundToInt(from)) + "->" + juce::String(juce::roundToInt(to)));
+    };
+    note("k", (float) requested.kmK, (float) effective.kmK);
+    note("iters", (float) requested.kmIterations, (float) effective.kmIterations);
+    note("refresh", (float) requested.kmRefreshInterval, (float) effective.kmRefreshInterval);
+    note("max clusters", requested.rtefcMaxClusters, effective.rtefcMaxClusters);
+    
+    return "quality   level " + juce::String(level) + "/" + juce::String(QualityGovernor::maxLevel) + ": " + changes.joinIntoString(", ");
+}
+
+void RTWavesetsAudioProcessorEditor::updateViewedChannels()
+{
+    // one item per active group, named after its channels, so the plot always says
+    // which part of a multichannel input it covers
+    juce::StringArray items;
+    for (int g = 0; g < audioProcessor.getNumActiveGroups(); ++g)
+    {
+        const auto channels = audioProcessor.getGroupChannels(g);
+        if (channels.getLength() > 1)
+            items.add("Showing ch " + juce::String(channels.getStart() + 1) + "-" + juce::String(channels.getEnd()));
+        else if (channels.getLength() == 1)
+            items.add("Showing ch " + juce::String(channels.getStart() + 1));
+    }
+    
+    if (items != viewedChannelsItems)
+    {
+        viewedChannelsItems = items;
+        viewedChannelsCombo.clear(juce::dontSendNotification);
+        viewedChannelsCombo.addItemList(items, 1);
+    }
+    
+    viewedChannelsCombo.setSelectedId(audioProcessor.getVisualizedGroup() + 1, juce::dontSendNotification);
 }
@@ -35,28 +35,52 @@ private:
     
     //mode
     juce::ComboBox engineModeCombo;
+    juce::ComboBox channelLinkCombo;
+    
+    // which channel group the plot and the cluster telemetry show; its items follow
+    // the processor's grouping
+    juce::ComboBox viewedChannelsCombo;
+    juce::StringArray viewedChannelsItems;
+    void updateViewedChannels();
     
     // rtefc
     juce::Slider radiusSlider, alphaSlider, lengthWeightSlider, clusterDensitySlider, halfLifeSlider;
     juce::ToggleButton autoRadiusToggle { "Auto Radius" };
     
     //kmeans
-    juce::Slider kmKSlider, kmWindowSlider, kmRefreshSlider, kmItersSlider, kmLenWeightSlider;
+    juce::Slider kmKSlider, kmWindowSlider, kmRefreshSlider, kmItersSlider, kmLenWeightSlider, kmRefreshBudgetSlider;
+    juce::ToggleButton kmWarmStartToggle { "Warm Start (reuse last clusters)" };
+    
+    // segmentation
+    juce::Slider zcHysteresisSlider, zcMinLengthSlider;
     
     // general
     juce::TextButton resetClustersButton { "Reset Clusters" };
     juce::TextButton resetAllButton { "Reset All" };
 
     //labels
-    juce::Label modeLabel;
+    juce::Label modeLabel, channelLinkLabel;
     juce::Label radiusLabel, alphaLabel, lengthWeightLabel, clusterDensityLabel, halfLifeLabel, autoRadiusLabel;
-    juce::Label kmKLabel, kmWindowLabel, kmRefreshLabel, kmItersLabel, kmLenWeightLabel;
+    juce::Label kmKLabel, kmWindowLabel, kmRefreshLabel, kmItersLabel, kmLenWeightLabel, kmRefreshBudgetLabel;
+    juce::Label zcHysteresisLabel, zcMinLengthLabel;
     
     //telemetry
     juce::Label clustersLabel, distanceLabel, windowCountLabel;
+    
+    // cpu load: latest block, p99 over the last few seconds, peak since prepareToPlay
+    juce::Label blockLoadLabel, rtefcLoadLabel, kmeansLoadLabel;
+    static constexpr int loadWindowPolls = 30; // 3 s at the timer rate
+    LoadHistogramWindow blockLoadWindow { loadWindowPolls }, rtefcLoadWindow { loadWindowPolls }, kmeansLoadWindow { loadWindowPolls };
+    
+    // quality governor: what it currently holds back, and its last few steps
+    juce::Label qualityLabel, qualityLogLabel;
+    juce::StringArray qualityLog;
+    static constexpr int qualityLogLines = 3;
+    juce::String describeQuality(int level) const;
 
     //attachments
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> modeAtt;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> channelLinkAtt;
     std::unique_ptr<ClusterVisualizationComponent> visualizationComponent;
     juce::AudioProcessorValueTreeState::SliderAttachment radiusAtt { audioProcessor.apvts, "radius", radiusSlider };
     juce::AudioProcessorValueTreeState::SliderAttachment alphaAtt { audioProcessor.apvts, "alpha", alphaSlider };
@@ -71,6 +95,11 @@ private:
     juce::AudioProcessorValueTreeState::SliderAttachment kmRefreshAtt { audioProcessor.apvts, "km_refresh", kmRefreshSlider };
     juce::AudioProcessorValueTreeState::SliderAttachment kmItersAtt { audioProcessor.apvts, "km_iters", kmItersSlider };
     juce::AudioProcessorValueTreeState::SliderAttachment kmLenWeightAtt { audioProcessor.apvts, "km_length_weight", kmLenWeightSlider };
+    juce::AudioProcessorValueTreeState::SliderAttachment kmRefreshBudgetAtt { audioProcessor.apvts, "km_refresh_budget", kmRefreshBudgetSlider };
+    juce::AudioProcessorValueTreeState::ButtonAttachment kmWarmStartAtt { audioProcessor.apvts, "km_warm_start", kmWarmStartToggle };
+    
+    juce::AudioProcessorValueTreeState::SliderAttachment zcHysteresisAtt { audioProcessor.apvts, "zc_hysteresis", zcHysteresisSlider };
+    juce::AudioProcessorValueTreeState::SliderAttachment zcMinLengthAtt { audioProcessor.apvts, "zc_min_length", zcMinLengthSlider };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RTWavesetsAudioProcessorEditor)
 };
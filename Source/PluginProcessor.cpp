@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeGuard.h"
 
 //==============================================================================
 RTWavesetsAudioProcessor::RTWavesetsAudioProcessor()
@@ -40,12 +41,29 @@ RTWavesetsAudioProcessor::RTWavesetsAudioProcessor()
     apvts.addParameterListener("km_refresh", this);
     apvts.addParameterListener("km_iters", this);
     apvts.addParameterListener("km_length_weight", this);
+    apvts.addParameterListener("km_warm_start", this);
+    apvts.addParameterListener("km_refresh_budget", this);
+    
+    apvts.addParameterListener("quality_governor", this);
+    
+    // segmentation params
+    apvts.addParameterListener("zc_hysteresis", this);
+    apvts.addParameterListener("zc_min_length", this);
+    apvts.addParameterListener("channel_link", this);
+    
+    // the first group is there from the start, for the editor
+    groups[0] = std::make_unique<ChannelGroup>(*this);
+    numGroups.store(1);
 }
 
 RTWavesetsAudioProcessor::~RTWavesetsAudioProcessor()
 {
+    for (int g = 0; g < numGroups.load(); ++g)
+        workerPool->remove(groups[(size_t) g]->analysisClient);
+    
     for (auto id : { "radius","alpha","length_weight","clusters_per_second","norm_half_life","auto_radius","reset_clusters","reset_all",
-                         "engine_mode","km_k","km_window","km_refresh","km_iters","km_length_weight" })
+                         "engine_mode","km_k","km_window","km_refresh","km_iters","km_length_weight","km_warm_start","km_refresh_budget","quality_governor",
+                         "zc_hysteresis","zc_min_length","channel_link" })
             apvts.removeParameterListener(id, this);
 }
 
@@ -114,35 +132,68 @@ void RTWavesetsAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void RTWavesetsAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    rtefcEngine.prepare(sampleRate);
-    kmeansEngine.prepare(sampleRate);
+    // the analysis clients own the engines while they are in the pool; take them out
+    // before touching anything
+    for (int g = 0; g < numGroups.load(); ++g)
+        workerPool->remove(groups[(size_t) g]->analysisClient);
+    analyseInline = isNonRealtime();
     
-    const int numChannels = 2;
-    const int bufferSize = static_cast<int>(sampleRate * 2.0);
+    // one group per channel covers either linking. groups only ever get added, so
+    // anyone holding on to one (the editor, a parameter listener) is never left dangling
+    numChannels = juce::jlimit(1, maxChannels, getTotalNumOutputChannels());
+    for (int g = numGroups.load(); g < numChannels; ++g)
+        groups[(size_t) g] = std::make_unique<ChannelGroup>(*this);
+    numGroups.store(std::max(numGroups.load(), numChannels), std::memory_order_release);
     
-    inputAssemblyBuffer.setSize(numChannels, bufferSize);
-    inputAssemblyBuffer.clear();
-    inputAssemblyBufferWritePosition = 0;
+    // only the groups a pair can land in need stereo storage
+    analysisSliceSamples = std::max(1, (int) (sampleRate * analysisSliceSeconds));
+    for (int g = 0; g < numChannels; ++g)
+        groups[(size_t) g]->prepare(sampleRate, samplesPerBlock, g < numChannels / 2 ? 2 : 1);
     
-    currentOutputWaveset.setSize(numChannels, bufferSize);
-    currentOutputWaveset.clear();
-    outputReadPosition = 0;
+    visualizationIntervalSamples = std::max(1, (int) (sampleRate / visualizationRateHz));
+    blocksSincePrepare = 0;
     
-    scratchWaveset.setSize(numChannels, bufferSize);
-    scratchWaveset.clear();
+    ticksPerSample = (double) juce::Time::getHighResolutionTicksPerSecond() / sampleRate;
+    blockLoad.reset();
+    rtefcLoad.reset();
+    kmeansLoad.reset();
+    governor.prepare(sampleRate);
+    governorSamples = 0;
     
-    lastSign = 0;
-    isFirstWavesetProcessed = false;
+    // processing is stopped, so this thread stands in for every consumer: whatever is
+    // still queued is stale next to the current values, and resets are moot after prepare
+    audioThreadCommands.drain([] (const EngineCommand&) {});
+    audioThreadCommandsDropped.store(false);
+    for (int g = 0; g < numGroups.load(); ++g)
+    {
+        auto& group = *groups[(size_t) g];
+        group.commands.drain([] (const EngineCommand&) {});
+        group.commandsDropped.store(false);
+        group.resetAllRequested.store(false);
+        group.resetClustersRequested.store(false);
+        group.blockPending.store(false);
+    }
     
-    parameterChanged("radius", apvts.getRawParameterValue("radius")->load());
-    parameterChanged("engine_mode", apvts.getRawParameterValue("engine_mode")->load());
+    for (int g = 0; g < numChannels; ++g)
+        groups[(size_t) g]->applyCurrentParameters();
+    applyAudioThreadCommand(makeSegmentationCommand());
+    setLinking(makeLinkingCommand().linking, false);
+    
+    // playback waits on analysis, refreshes only make it better. offline the clients
+    // only take whole blocks, see processGroupsInParallel
+    for (int g = 0; g < numChannels; ++g)
+        workerPool->add(groups[(size_t) g]->analysisClient, WorkerPool::Priority::high);
 }
 
 void RTWavesetsAudioProcessor::releaseResources()
 {
-    inputAssemblyBuffer.setSize(0, 0);
-    currentOutputWaveset.setSize(0, 0);
-    scratchWaveset.setSize(0, 0);
+    for (int g = 0; g < numGroups.load(); ++g)
+    {
+        auto& group = *groups[(size_t) g];
+        workerPool->remove(group.analysisClient);
+        group.segmenter.release();
+        group.resetPlayback();
+    }
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -152,20 +203,17 @@ bool RTWavesetsAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // any layout up to maxChannels: the channels are split into groups, see ChannelLinking
+    const auto& output = layouts.getMainOutputChannelSet();
+    if (output.isDisabled() || output.size() > maxChannels)
         return false;
-
+    
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
    #endif
-
+   
     return true;
   #endif
 }
@@ -173,98 +221,382 @@ bool RTWavesetsAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
 
 void RTWavesetsAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    const auto blockStart = juce::Time::getHighResolutionTicks();
+    
     juce::ScopedNoDenormals noDenormals;
+    
+    // checked builds count heap traffic and locks from here on, per call site. the first
+    // few blocks after prepareToPlay and offline renders are only tallied, not flagged
+    blocksSincePrepare = std::min(blocksSincePrepare + 1, realtimeWarmUpBlocks + 1);
+    RTWAVESETS_REALTIME_SCOPE("processBlock", blocksSincePrepare > realtimeWarmUpBlocks && ! isNonRealtime());
+    
+    drainAudioThreadCommands();
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
-
+    const int numSamples = buffer.getNumSamples();
+    
+    // outputs past the inputs (mono into stereo) start out as a copy of the last input,
+    // so every group works in place
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
+    {
+        if (totalNumInputChannels > 0)
+            buffer.copyFrom(i, 0, buffer, totalNumInputChannels - 1, 0, numSamples);
+        else
+            buffer.clear(i, 0, numSamples);
+    }
+    
+    if (analyseInline)
+        for (int g = 0; g < numChannels; ++g)
+            groups[(size_t) g]->drainCommands();
+    
+    const int activeGroups = numActiveGroups.load(std::memory_order_relaxed);
+    if (analyseInline && activeGroups > 1)
+    {
+        processGroupsInParallel(buffer, numSamples);
+    }
+    else
+    {
+        for (int g = 0; g < activeGroups; ++g)
+            groups[(size_t) g]->process(buffer, numSamples);
+    }
+    
+    if (numSamples > 0 && ticksPerSample > 0.0)
+        blockLoad.add((float) ((double) (juce::Time::getHighResolutionTicks() - blockStart) / (ticksPerSample * numSamples)));
+}
+
+void RTWavesetsAudioProcessor::processGroupsInParallel(juce::AudioBuffer<float>& buffer, int numSamples)
+{
+    const int n = numActiveGroups.load(std::memory_order_relaxed);
+    parallelBuffer = &buffer;
+    parallelNumSamples = numSamples;
+    groupsDone.store(0, std::memory_order_relaxed);
+    
+    for (int g = 0; g < n; ++g)
+        groups[(size_t) g]->blockPending.store(true, std::memory_order_release);
+    workerPool->notify();
+    
+    // take on whatever the pool hasn't got to yet, then wait for the rest
+    for (int g = n; --g >= 0;)
+        runPendingBlock(*groups[(size_t) g]);
+    
+    while (groupsDone.load(std::memory_order_acquire) < n)
+        juce::Thread::yield();
+}
 
-    auto* leftOut = buffer.getWritePointer(0);
-    const auto* leftIn = buffer.getReadPointer(0);
-    const auto* rightIn = totalNumInputChannels > 1 ? buffer.getReadPointer(1) : buffer.getReadPointer(0);
+bool RTWavesetsAudioProcessor::runPendingBlock(ChannelGroup& group)
+{
+    if (! group.blockPending.exchange(false, std::memory_order_acquire))
+        return false;
+    
+    group.process(*parallelBuffer, parallelNumSamples);
+    groupsDone.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void RTWavesetsAudioProcessor::setLinking(ChannelLinking newLinking, bool resetEngines)
+{
+    linking = newLinking;
+    const int groupSize = (linking == ChannelLinking::pairs) ? 2 : 1;
+    const int active = (numChannels + groupSize - 1) / groupSize;
     
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    for (int g = 0; g < active; ++g)
     {
-        const float leftSample = leftIn[i];
-        const float rightSample = rightIn[i];
+        auto& group = *groups[(size_t) g];
+        group.setChannels(g * groupSize, std::min(groupSize, numChannels - g * groupSize));
+        group.resetPlayback();
         
-        // start assembling waveset buffer
-        if (inputAssemblyBufferWritePosition < inputAssemblyBuffer.getNumSamples())
-        {
-            inputAssemblyBuffer.setSample(0, inputAssemblyBufferWritePosition, leftSample);
-            inputAssemblyBuffer.setSample(1, inputAssemblyBufferWritePosition, rightSample);
-            inputAssemblyBufferWritePosition++;
-        }
+        if (! resetEngines)
+            continue;
         
-        // detect zero-crossings on left channel
-        int currentSign = (leftSample > 0.0f) - (leftSample < 0.0f);
-        if (currentSign > 0 && lastSign <= 0)
+        // what a group learnt on its old channels means nothing on the new ones
+        if (analyseInline)
         {
-            const int wsLen = inputAssemblyBufferWritePosition;
-            if (wsLen > 1 && wsLen <= scratchWaveset.getNumSamples())
-            {
-                // copy into scratch
-                scratchWaveset.clear();
-                scratchWaveset.copyFrom(0, 0, inputAssemblyBuffer, 0, 0, wsLen);
-                scratchWaveset.copyFrom(1, 0, inputAssemblyBuffer, 1, 0, wsLen);
-
-                // create a view buffer of exact length without realloc
-                juce::AudioBuffer<float> wsView (scratchWaveset.getArrayOfWritePointers(), 2, wsLen);
-                
-                const EngineMode m = mode.load();
-                const juce::AudioBuffer<float>* rep = nullptr;
-                
-                if (m == EngineMode::RTEFC)
-                {
-                    rep = &rtefcEngine.processWaveset(wsView);
-                }
-                else
-                {
-                    rep = &kmeansEngine.processWaveset(wsView);
-                }
-                
-                if (rep != nullptr)
-                {
-                    const int copyLen = std::min(rep->getNumSamples(), currentOutputWaveset.getNumSamples());
-                    if (copyLen > 0)
-                    {
-                        currentOutputWaveset.clear();
-                        currentOutputWaveset.copyFrom(0, 0, *rep, 0, 0, copyLen);
-                        if (currentOutputWaveset.getNumChannels() > 1 && rep->getNumChannels() > 1)
-                            currentOutputWaveset.copyFrom(1, 0, *rep, 1, 0, copyLen);
-
-                        outputReadPosition = 0;
-                        isFirstWavesetProcessed = true;
-                    }
-                }
-            }
-            
-            inputAssemblyBuffer.clear();
-            inputAssemblyBufferWritePosition = 0;
-        }
-        lastSign = currentSign;
-        
-        // write to output buffer
-        if (isFirstWavesetProcessed && outputReadPosition < currentOutputWaveset.getNumSamples())
-        {
-            leftOut[i] = currentOutputWaveset.getSample(0, outputReadPosition);
-            if (totalNumOutputChannels > 1)
-            {
-                buffer.getWritePointer(1)[i] = currentOutputWaveset.getSample(1, outputReadPosition);
-            }
-            outputReadPosition++;
+            EngineCommand c;
+            c.type = EngineCommand::Type::resetAll;
+            group.applyCommand(c);
         }
         else
         {
-            // pass through until representative waveset is ready
-            leftOut[i] = leftSample;
-            if (totalNumOutputChannels > 1)
-            {
-                buffer.getWritePointer(1)[i] = rightSample;
-            }
+            group.resetAllRequested.store(true);
         }
     }
+    
+    activeGroupSize.store(groupSize, std::memory_order_relaxed);
+    numGroupedChannels.store(numChannels, std::memory_order_relaxed);
+    numActiveGroups.store(active, std::memory_order_relaxed);
+}
+
+void RTWavesetsAudioProcessor::updateGovernor(float load, int numSamples)
+{
+    // offline there is no deadline, and a render should sound like its settings
+    if (analyseInline)
+        return;
+    
+    RTWAVESETS_REALTIME_LOCK();
+    const juce::SpinLock::ScopedLockType sl (governorLock);
+    if (! governorEnabled)
+        return;
+    
+    // the groups run side by side, so each one's waveset only stands for its share of
+    // the time that passes
+    const int sharedBy = std::max(1, numActiveGroups.load(std::memory_order_relaxed));
+    governorSamples += numSamples;
+    const int share = governorSamples / sharedBy;
+    governorSamples -= share * sharedBy;
+    
+    QualityGovernor::Adjustment adjustment;
+    if (governor.update(load, share, adjustment))
+        qualityAdjustments.push(adjustment); // nobody drains it without an editor; dropping is fine
+}
+
+void RTWavesetsAudioProcessor::setGovernorEnabled(bool shouldBeEnabled)
+{
+    RTWAVESETS_REALTIME_LOCK();
+    const juce::SpinLock::ScopedLockType sl (governorLock);
+    governorEnabled = shouldBeEnabled;
+    
+    if (! governorEnabled && governor.getLevel() != 0)
+    {
+        const QualityGovernor::Adjustment restored { governor.getLevel(), 0, 0.0f, juce::Time::getMillisecondCounter() };
+        governor.reset();
+        qualityAdjustments.push(restored);
+    }
+}
+
+void RTWavesetsAudioProcessor::setVisualizedGroup(int group) noexcept
+{
+    visualizedGroup.store(juce::jlimit(0, maxChannels - 1, group), std::memory_order_relaxed);
+}
+
+int RTWavesetsAudioProcessor::getVisualizedGroup() const noexcept
+{
+    const int group = visualizedGroup.load(std::memory_order_relaxed);
+    return group < std::min(numActiveGroups.load(std::memory_order_relaxed), numGroups.load(std::memory_order_acquire)) ? group : 0;
+}
+
+juce::Range<int> RTWavesetsAudioProcessor::getGroupChannels(int group) const noexcept
+{
+    if (group < 0 || group >= numActiveGroups.load(std::memory_order_relaxed))
+        return {};
+    
+    const int size = activeGroupSize.load(std::memory_order_relaxed);
+    const int first = group * size;
+    return { first, std::min(first + size, numGroupedChannels.load(std::memory_order_relaxed)) };
+}
+
+RTEFC_Engine& RTWavesetsAudioProcessor::getRtefcEngine() noexcept
+{
+    return groups[(size_t) getVisualizedGroup()]->rtefcEngine;
+}
+
+KMeansWindowEngine& RTWavesetsAudioProcessor::getKMeansEngine() noexcept
+{
+    return groups[(size_t) getVisualizedGroup()]->kmeansEngine;
+}
+
+//==============================================================================
+void RTWavesetsAudioProcessor::ChannelGroup::prepare(double sampleRate, int samplesPerBlock, int numStorageChannels)
+{
+    rtefcEngine.prepare(sampleRate, numStorageChannels);
+    kmeansEngine.prepare(sampleRate, processor.analyseInline, numStorageChannels);
+    
+    // every buffer on the way to the engines and back holds the longest waveset
+    const int bufferSize = static_cast<int>(sampleRate * 2.0);
+    segmenter.prepare(numStorageChannels, bufferSize, samplesPerBlock);
+    wavesetQueue.prepare(numStorageChannels, (int) (sampleRate * queueSeconds), maxQueuedWavesets);
+    analysisWaveset.setSize(numStorageChannels, bufferSize);
+    representatives.forEachBuffer([=] (PlaybackRepresentative& r)
+    {
+        r.audio.setSize(numStorageChannels, bufferSize);
+        r.numSamples = 0;
+    });
+    lastPublished = {};
+    
+    outputPeriodLength = bufferSize;
+    resetPlayback();
+    
+    samplesSinceVisualization = 0;
+    appliedQualityLevel = 0;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::setChannels(int first, int num) noexcept
+{
+    firstChannel = first;
+    numChannels = num;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::resetPlayback() noexcept
+{
+    segmenter.reset();
+    currentOutputWaveset = {};
+    outputReadPosition = 0;
+    isFirstWavesetProcessed = false;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::process(juce::AudioBuffer<float>& buffer, int numSamples)
+{
+    // crossings are found on the group's first channel, the other one follows along
+    const int n = std::min(numChannels, buffer.getNumChannels() - firstChannel);
+    if (n <= 0)
+        return;
+    
+    int renderedUpTo = 0;
+    segmenter.process(buffer.getArrayOfReadPointers() + firstChannel, n, numSamples,
+                      [&] (int crossingIndex, const juce::AudioBuffer<float>& waveset)
+    {
+        // everything before the crossing still plays the previous representative
+        renderOutput(buffer, renderedUpTo, crossingIndex);
+        renderedUpTo = crossingIndex;
+        
+        // realtime the analysis client takes it from here. if it has fallen so far behind
+        // that the queue is full, this waveset just goes unanalysed
+        if (processor.analyseInline)
+            analyseWaveset(waveset);
+        else
+            wavesetQueue.push(waveset);
+        
+        // inline that is this waveset's own representative, otherwise the newest one
+        // the analysis client has come up with so far
+        adoptRepresentative();
+    });
+    
+    renderOutput(buffer, renderedUpTo, numSamples);
+    
+    if (processor.analyseInline)
+        serviceEngines(numSamples);
+}
+
+bool RTWavesetsAudioProcessor::ChannelGroup::AnalysisClient::service()
+{
+    if (group.processor.analyseInline)
+        return group.processor.runPendingBlock(group);
+    
+    group.drainCommands();
+    return group.analyseQueued();
+}
+
+bool RTWavesetsAudioProcessor::ChannelGroup::analyseQueued()
+{
+    // a slice's worth, then the other clients get their turn
+    int analysed = 0;
+    while (analysed < processor.analysisSliceSamples && wavesetQueue.pop(analysisWaveset))
+    {
+        analyseWaveset(analysisWaveset);
+        analysed += analysisWaveset.getNumSamples();
+    }
+    
+    serviceEngines(analysed);
+    return analysed > 0;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::analyseWaveset(const juce::AudioBuffer<float>& waveset)
+{
+    const auto start = juce::Time::getHighResolutionTicks();
+    
+    const EngineMode m = mode;
+    const WavesetHandle rep = (m == EngineMode::RTEFC) ? rtefcEngine.processWaveset(waveset)
+                                                       : kmeansEngine.processWaveset(waveset);
+    if (! rep.isEmpty())
+        publishRepresentative(rep);
+    
+    const int numSamples = waveset.getNumSamples();
+    if (numSamples > 0 && processor.ticksPerSample > 0.0)
+    {
+        const auto load = (float) ((double) (juce::Time::getHighResolutionTicks() - start) / (processor.ticksPerSample * numSamples));
+        (m == EngineMode::RTEFC ? processor.rtefcLoad : processor.kmeansLoad).add(load);
+        processor.updateGovernor(load, numSamples);
+        followGovernor();
+    }
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::publishRepresentative(const WavesetHandle& rep)
+{
+    // the audio thread restarts whatever it holds at each crossing, so the same
+    // representative again needs no new copy
+    if (rep.channels[0] == lastPublished.channels[0] && rep.numSamples == lastPublished.numSamples
+        && rep.generation == lastPublished.generation)
+        return;
+    
+    // the handle is only good until the engine's next waveset, so copy it out now
+    auto& out = representatives.getWriteBuffer();
+    out.numSamples = std::min(rep.numSamples, out.audio.getNumSamples());
+    for (int ch = 0; ch < out.audio.getNumChannels() && out.numSamples > 0; ++ch)
+        out.audio.copyFrom(ch, 0, rep.getReadPointer(ch), out.numSamples);
+    
+    representatives.publish();
+    lastPublished = rep;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::clearRepresentative()
+{
+    representatives.getWriteBuffer().numSamples = 0;
+    representatives.publish();
+    lastPublished = {};
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::adoptRepresentative()
+{
+    // the previous read buffer may be rewritten from here on, so stop reading it right away
+    if (representatives.acquire())
+    {
+        currentOutputWaveset = representatives.getReadBuffer().getHandle();
+        isFirstWavesetProcessed = ! currentOutputWaveset.isEmpty();
+    }
+    
+    if (isFirstWavesetProcessed)
+        outputReadPosition = 0;
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::serviceEngines(int numSamples)
+{
+    const EngineMode activeMode = mode;
+    if (activeMode == EngineMode::WindowedKMeans)
+        kmeansEngine.advanceRefresh();
+    
+    // only the editor reads snapshots, and it shows one group
+    if (this != processor.groups[(size_t) processor.getVisualizedGroup()].get())
+        return;
+    
+    samplesSinceVisualization += numSamples;
+    if (samplesSinceVisualization >= processor.visualizationIntervalSamples)
+    {
+        samplesSinceVisualization = 0;
+        if (activeMode == EngineMode::RTEFC)
+            rtefcEngine.publishVisualization();
+        else
+            kmeansEngine.publishVisualization();
+    }
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::renderOutput(juce::AudioBuffer<float>& buffer, int startSample, int endSample)
+{
+    // until the first representative is ready the input passes through; the buffer is
+    // processed in place, so that needs nothing
+    if (! isFirstWavesetProcessed)
+        return;
+    
+    const int n = std::min(numChannels, buffer.getNumChannels() - firstChannel);
+    int pos = startSample;
+    
+    // representative audio
+    const int fromRep = juce::jlimit(0, endSample - pos, currentOutputWaveset.numSamples - outputReadPosition);
+    if (fromRep > 0)
+    {
+        for (int ch = 0; ch < n; ++ch)
+            buffer.copyFrom(firstChannel + ch, pos, currentOutputWaveset.getReadPointer(ch, outputReadPosition), fromRep);
+        outputReadPosition += fromRep;
+        pos += fromRep;
+    }
+    
+    // silence after the representative ends, until the assembly period runs out
+    const int silent = juce::jlimit(0, endSample - pos, outputPeriodLength - outputReadPosition);
+    if (silent > 0)
+    {
+        for (int ch = 0; ch < n; ++ch)
+            buffer.clear(firstChannel + ch, pos, silent);
+        outputReadPosition += silent;
+    }
 }
 
 //==============================================================================
@@ -303,73 +635,283 @@ void RTWavesetsAudioProcessor::setStateInformation (const void* data, int sizeIn
 
 void RTWavesetsAudioProcessor::parameterChanged(const juce::String &parameterID, float newValue)
 {
-    if (parameterID == "reset_all")
+    // this runs on whichever thread changed the parameter, so nothing here touches the
+    // engines: the change goes over to the thread that owns them as a command
+    if (parameterID == "reset_all" || parameterID == "reset_clusters")
     {
+        // a flag per group rather than a queued command, so a press is never lost to a
+        // full queue; the editor puts the parameter back to 0 once it sees it set
         if (newValue > 0.5f)
         {
-            DBG("reset all triggered");
-            rtefcEngine.resetAll();
-            kmeansEngine.resetAll();
-            isFirstWavesetProcessed = false;
-            
-            juce::MessageManager::callAsync([this]() {
-                if (auto* p = apvts.getParameter("reset_all")) p->setValueNotifyingHost(0.0f);
-            });
+            const bool all = parameterID == "reset_all";
+            const int n = numGroups.load(std::memory_order_acquire);
+            for (int g = 0; g < n; ++g)
+                (all ? groups[(size_t) g]->resetAllRequested : groups[(size_t) g]->resetClustersRequested).store(true);
         }
         return;
     }
     
-    if (parameterID == "reset_clusters")
+    if (parameterID == "engine_mode")
     {
-        if (newValue > 0.5f)
-        {
-            DBG("reset clusters triggered");
-            rtefcEngine.resetClustersOnly();
-            kmeansEngine.resetAll();
-            isFirstWavesetProcessed = false;
-            
-            juce::MessageManager::callAsync([this]() {
-                if (auto* p = apvts.getParameter("reset_clusters")) p->setValueNotifyingHost(0.0f);
-            });
-        }
+        postCommand(makeModeCommand());
         return;
     }
     
-    if (parameterID == "engine_mode")
+    if (parameterID == "zc_hysteresis" || parameterID == "zc_min_length")
     {
-        const int m = (int)newValue;
-        mode.store(m == 0 ? EngineMode::RTEFC : EngineMode::WindowedKMeans);
+        postCommand(makeSegmentationCommand());
         return;
     }
     
-    DBG("Parameter changed: " << parameterID << " to " << newValue);
-    const float radius    = apvts.getRawParameterValue("radius")->load();
-    const float alpha     = apvts.getRawParameterValue("alpha")->load();
-    const float lenWeight = apvts.getRawParameterValue("length_weight")->load();
-    const float cps       = apvts.getRawParameterValue("clusters_per_second")->load();
-    const float halfLife  = apvts.getRawParameterValue("norm_half_life")->load();
-    const bool  autoRad   = apvts.getRawParameterValue("auto_radius")->load() > 0.5f;
+    if (parameterID == "channel_link")
+    {
+        postCommand(makeLinkingCommand());
+        return;
+    }
+    
+    if (parameterID == "quality_governor")
+    {
+        postCommand(makeGovernorCommand());
+        return;
+    }
+    
+    if (parameterID.startsWith("km_"))
+        postCommand(makeKMeansCommand());
+    else
+        postCommand(makeRtefcCommand());
+}
+
+void RTWavesetsAudioProcessor::postCommand(const EngineCommand& command)
+{
+    if (command.type == EngineCommand::Type::setSegmentation || command.type == EngineCommand::Type::setLinking)
+    {
+        if (! audioThreadCommands.push(command))
+            audioThreadCommandsDropped.store(true);
+        return;
+    }
+    
+    // groups that don't exist yet start from the parameter values when they are prepared
+    const int n = numGroups.load(std::memory_order_acquire);
+    for (int g = 0; g < n; ++g)
+    {
+        auto& group = *groups[(size_t) g];
+        if (! group.commands.push(command))
+            group.commandsDropped.store(true);
+    }
+}
 
-    const float maxClusters = cps;
+void RTWavesetsAudioProcessor::drainAudioThreadCommands()
+{
+    audioThreadCommands.drain([this] (const EngineCommand& c) { applyAudioThreadCommand(c); });
     
-    // detect large parameter changes to trigger reset
-    const bool bigRadiusChange = std::abs(prevRadius - radius) / std::max(0.001f, prevRadius) > 0.25f;
-    const bool bigWeightChange = std::abs(prevLengthWeight - lenWeight) / std::max(0.001f, prevLengthWeight) > 0.25f;
-    if (bigRadiusChange || bigWeightChange)
-        rtefcEngine.resetClustersOnly();
+    if (audioThreadCommandsDropped.exchange(false))
+    {
+        applyAudioThreadCommand(makeSegmentationCommand());
+        applyAudioThreadCommand(makeLinkingCommand());
+    }
+}
+
+void RTWavesetsAudioProcessor::applyAudioThreadCommand(const EngineCommand& c)
+{
+    if (c.type == EngineCommand::Type::setSegmentation)
+    {
+        for (int g = 0; g < numChannels; ++g)
+        {
+            groups[(size_t) g]->segmenter.setHysteresis(c.zcHysteresis);
+            groups[(size_t) g]->segmenter.setMinimumLength(c.zcMinLength);
+        }
+    }
+    else if (c.type == EngineCommand::Type::setLinking && c.linking != linking)
+    {
+        setLinking(c.linking, true);
+    }
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::drainCommands()
+{
+    commands.drain([this] (const EngineCommand& c) { applyCommand(c); });
+    
+    // parameter commands that didn't fit are recovered from the values themselves
+    if (commandsDropped.exchange(false))
+        applyCurrentParameters();
+    
+    // a full reset covers a clusters-only one asked for alongside it
+    const bool resetAll = resetAllRequested.exchange(false);
+    const bool resetClusters = resetClustersRequested.exchange(false);
+    if (resetAll || resetClusters)
+    {
+        EngineCommand c;
+        c.type = resetAll ? EngineCommand::Type::resetAll : EngineCommand::Type::resetClusters;
+        applyCommand(c);
+    }
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::applyCurrentParameters()
+{
+    applyCommand(processor.makeModeCommand());
+    applyCommand(processor.makeRtefcCommand());
+    applyCommand(processor.makeKMeansCommand());
+    applyCommand(processor.makeGovernorCommand());
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::applyCommand(const EngineCommand& c)
+{
+    switch (c.type)
+    {
+        case EngineCommand::Type::resetAll:
+            rtefcEngine.resetAll();
+            kmeansEngine.resetAll();
+            clearRepresentative();
+            break;
+        
+        case EngineCommand::Type::resetClusters:
+            rtefcEngine.resetClustersOnly();
+            kmeansEngine.resetAll();
+            clearRepresentative();
+            break;
+        
+        case EngineCommand::Type::setMode:
+            mode = c.mode;
+            break;
+        
+        // the audio thread applies these itself, see postCommand()
+        case EngineCommand::Type::setSegmentation:
+        case EngineCommand::Type::setLinking:
+            break;
+        
+        case EngineCommand::Type::setRtefcParameters:
+        {
+            const auto& p = c.rtefc;
+            
+            // detect large parameter changes to trigger reset
+            const bool bigRadiusChange = std::abs(prevRadius - p.radius) / std::max(0.001f, prevRadius) > 0.25f;
+            const bool bigWeightChange = std::abs(prevLengthWeight - p.lengthWeight) / std::max(0.001f, prevLengthWeight) > 0.25f;
+            if (bigRadiusChange || bigWeightChange)
+                rtefcEngine.resetClustersOnly();
+            
+            requestedRtefc = p;
+            applyRtefcParameters();
+            
+            prevRadius = p.radius;
+            prevLengthWeight = p.lengthWeight;
+            break;
+        }
+        
+        case EngineCommand::Type::setKMeansParameters:
+            requestedKMeans = c.kmeans;
+            applyKMeansParameters();
+            break;
+        
+        // every group gets this; only the first to see it changes anything
+        case EngineCommand::Type::setGovernor:
+            processor.setGovernorEnabled(c.governorEnabled);
+            followGovernor();
+            break;
+    }
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::applyRtefcParameters()
+{
+    const auto& p = requestedRtefc;
+    QualitySettings requested;
+    requested.rtefcMaxClusters = p.maxClusters;
+    appliedQualityLevel = processor.governor.getLevel();
+    const auto s = QualityGovernor::apply(requested, appliedQualityLevel);
     
-    rtefcEngine.setParameters(radius, alpha, lenWeight, maxClusters, halfLife, autoRad);
+    rtefcEngine.setParameters(p.radius, p.alpha, p.lengthWeight, s.rtefcMaxClusters, p.normHalfLife, p.autoRadius);
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::applyKMeansParameters()
+{
+    const auto& p = requestedKMeans;
+    QualitySettings requested;
+    requested.kmK = p.k;
+    requested.kmIterations = p.iterations;
+    requested.kmRefreshInterval = p.refreshInterval;
+    appliedQualityLevel = processor.governor.getLevel();
+    const auto s = QualityGovernor::apply(requested, appliedQualityLevel);
     
-    prevRadius = radius;
-    prevLengthWeight = lenWeight;
+    kmeansEngine.setParameters(s.kmK, p.window, s.kmRefreshInterval, s.kmIterations, p.lengthWeight, p.warmStart);
+    kmeansEngine.setRefreshBudget(p.refreshBudget);
+}
+
+void RTWavesetsAudioProcessor::ChannelGroup::followGovernor()
+{
+    if (processor.governor.getLevel() == appliedQualityLevel)
+        return;
     
-    const int kmK        = (int) apvts.getRawParameterValue("km_k")->load();
-    const int kmWin      = (int) apvts.getRawParameterValue("km_window")->load();
-    const int kmRefresh  = (int) apvts.getRawParameterValue("km_refresh")->load();
-    const int kmIters    = (int) apvts.getRawParameterValue("km_iters")->load();
-    const float kmLW     = apvts.getRawParameterValue("km_length_weight")->load();
+    applyRtefcParameters();
+    applyKMeansParameters();
+}
 
-    kmeansEngine.setParameters(kmK, kmWin, kmRefresh, kmIters, kmLW);
+EngineCommand RTWavesetsAudioProcessor::makeModeCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setMode;
+    c.mode = ((int) apvts.getRawParameterValue("engine_mode")->load() == 0) ? EngineMode::RTEFC : EngineMode::WindowedKMeans;
+    return c;
+}
+
+EngineCommand RTWavesetsAudioProcessor::makeSegmentationCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setSegmentation;
+    c.zcHysteresis = apvts.getRawParameterValue("zc_hysteresis")->load();
+    c.zcMinLength = (int) apvts.getRawParameterValue("zc_min_length")->load();
+    return c;
+}
+
+EngineCommand RTWavesetsAudioProcessor::makeLinkingCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setLinking;
+    c.linking = ((int) apvts.getRawParameterValue("channel_link")->load() == 0) ? ChannelLinking::pairs : ChannelLinking::independent;
+    return c;
+}
+
+EngineCommand RTWavesetsAudioProcessor::makeRtefcCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setRtefcParameters;
+    c.rtefc.radius       = apvts.getRawParameterValue("radius")->load();
+    c.rtefc.alpha        = apvts.getRawParameterValue("alpha")->load();
+    c.rtefc.lengthWeight = apvts.getRawParameterValue("length_weight")->load();
+    c.rtefc.maxClusters  = apvts.getRawParameterValue("clusters_per_second")->load();
+    c.rtefc.normHalfLife = apvts.getRawParameterValue("norm_half_life")->load();
+    c.rtefc.autoRadius   = apvts.getRawParameterValue("auto_radius")->load() > 0.5f;
+    return c;
+}
+
+EngineCommand RTWavesetsAudioProcessor::makeKMeansCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setKMeansParameters;
+    c.kmeans.k               = (int) apvts.getRawParameterValue("km_k")->load();
+    c.kmeans.window          = (int) apvts.getRawParameterValue("km_window")->load();
+    c.kmeans.refreshInterval = (int) apvts.getRawParameterValue("km_refresh")->load();
+    c.kmeans.iterations      = (int) apvts.getRawParameterValue("km_iters")->load();
+    c.kmeans.lengthWeight    = apvts.getRawParameterValue("km_length_weight")->load();
+    c.kmeans.warmStart       = apvts.getRawParameterValue("km_warm_start")->load() > 0.5f;
+    c.kmeans.refreshBudget   = apvts.getRawParameterValue("km_refresh_budget")->load();
+    return c;
+}
+
+EngineCommand RTWavesetsAudioProcessor::makeGovernorCommand() const
+{
+    EngineCommand c;
+    c.type = EngineCommand::Type::setGovernor;
+    c.governorEnabled = apvts.getRawParameterValue("quality_governor")->load() > 0.5f;
+    return c;
+}
+
+QualitySettings RTWavesetsAudioProcessor::getRequestedQuality() const
+{
+    QualitySettings s;
+    s.kmK               = (int) apvts.getRawParameterValue("km_k")->load();
+    s.kmIterations      = (int) apvts.getRawParameterValue("km_iters")->load();
+    s.kmRefreshInterval = (int) apvts.getRawParameterValue("km_refresh")->load();
+    s.rtefcMaxClusters  = apvts.getRawParameterValue("clusters_per_second")->load();
+    return s;
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout RTWavesetsAudioProcessor::createParameterLayout()
@@ -378,7 +920,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout RTWavesetsAudioProcessor::cr
     
     params.push_back(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"engine_mode", 1},
             "Engine Mode", juce::StringArray{ "RTEFC", "Windowed K-Means" }, 0));
-            
+    
     //rtefc
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{"radius", 1}, "Radius", juce::NormalisableRange<float>(0.1f, 10.f, 0.0f, 0.4f), 1.5f));
@@ -393,7 +935,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout RTWavesetsAudioProcessor::cr
     
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{"clusters_per_second", 1}, "Cluster Density",
-        juce::NormalisableRange<float>(1.0f, 50.f, 0.0f, 0.45f), 12.0f));
+        juce::NormalisableRange<float>(1.0f, 4096.f, 0.0f, 0.2f), 12.0f));
     
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{"norm_half_life", 1}, "Normalization Half-Life",
@@ -405,25 +947,49 @@ juce::AudioProcessorValueTreeState::ParameterLayout RTWavesetsAudioProcessor::cr
     
     //k-means
     params.push_back(std::make_unique<juce::AudioParameterInt>(
-        juce::ParameterID{"km_k", 1}, "K (clusters)", 2, 32, 8)); // avoid degenerate k=1[1]
-
+        juce::ParameterID{"km_k", 1}, "K (clusters)", 2, 128, 8)); // avoid degenerate k=1[1]
+    
     params.push_back(std::make_unique<juce::AudioParameterInt>(
-        juce::ParameterID{"km_window", 1}, "Window (wavesets)", 64, 1024, 256)); // per-window stats[1]
-
+        juce::ParameterID{"km_window", 1}, "Window (wavesets)", 64, 4096, 256)); // per-window stats[1]
+    
     params.push_back(std::make_unique<juce::AudioParameterInt>(
         juce::ParameterID{"km_refresh", 1}, "Refresh Interval (wavesets)", 8, 128, 32));
-
+    
     params.push_back(std::make_unique<juce::AudioParameterInt>(
         juce::ParameterID{"km_iters", 1}, "Iterations/Refresh", 1, 8, 3));
-
+    
     params.push_back(std::make_unique<juce::AudioParameterFloat>(
         juce::ParameterID{"km_length_weight", 1}, "KMeans Length Weight",
         juce::NormalisableRange<float>(0.5f, 12.f, 0.0f, 0.5f), 5.0f));
-
+    
+    params.push_back(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID{"km_warm_start", 1}, "KMeans Warm Start", true)); // reuse last clusters between refreshes
+    
+    // 0 gives refreshes their own pool client; otherwise each block's analysis slice takes
+    // them over for this many us. it bounds work on the analysis worker, not the audio thread
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID{"km_refresh_budget", 1}, "KMeans Refresh Time per Analysis Block (us)",
+        juce::NormalisableRange<float>(0.0f, 2000.0f, 1.0f, 0.5f), 0.0f));
+    
+    //segmentation
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID{"zc_hysteresis", 1}, "Crossing Hysteresis",
+        juce::NormalisableRange<float>(0.0f, 0.1f, 0.0f, 0.4f), 0.0f));
+    
+    params.push_back(std::make_unique<juce::AudioParameterInt>(
+        juce::ParameterID{"zc_min_length", 1}, "Min Waveset Length (samples)", 0, 512, 0));
+    
+    // pairs keeps stereo images together; independent suits ambisonics and surround stems
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"channel_link", 1},
+            "Channel Linking", juce::StringArray{ "Pairs", "Independent" }, 0));
+    
     //general
     params.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"reset_clusters", 1}, "Reset Clusters", false));
     params.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"reset_all", 1}, "Reset All", false));
     
+    // lowers iterations, k and cluster caps while the cpu can't keep up, see QualityGovernor
+    params.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"quality_governor", 1}, "Adaptive Quality", true));
+    
     return { params.begin(), params.end() };
 }
 
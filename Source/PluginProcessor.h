@@ -11,6 +11,13 @@
 #include <JuceHeader.h>
 #include "RTEFC_Engine.h"
 #include "KMeansWindowEngine.h"
+#include "WavesetSegmenter.h"
+#include "LoadHistogram.h"
+#include "CommandQueue.h"
+#include "QualityGovernor.h"
+#include "WavesetQueue.h"
+#include "TripleBuffer.h"
+#include "WorkerPool.h"
 
 enum class EngineMode
 {
@@ -18,6 +25,62 @@ enum class EngineMode
     WindowedKMeans = 1
 };
 
+// how the channels split into groups, each with its own segmentation and engines
+enum class ChannelLinking
+{
+    pairs = 0,      // 1+2, 3+4, ...; an odd last channel goes alone, so stereo is one group
+    independent = 1 // every channel by itself, e.g. ambisonic components
+};
+
+// a parameter change on its way from whichever thread made it to the one that applies
+// it: segmentation and linking to the audio thread, everything else to each channel
+// group's engine side. parameter commands carry the whole group's values; the reset
+// types only ever travel as flags, see ChannelGroup::drainCommands()
+struct EngineCommand
+{
+    enum class Type { setMode, setSegmentation, setLinking, setRtefcParameters, setKMeansParameters, setGovernor, resetClusters, resetAll };
+    Type type = Type::setMode;
+    
+    EngineMode mode = EngineMode::RTEFC;
+    ChannelLinking linking = ChannelLinking::pairs;
+    bool governorEnabled = true;
+    
+    float zcHysteresis = 0.0f;
+    int zcMinLength = 0;
+    
+    struct
+    {
+        float radius, alpha, lengthWeight, maxClusters, normHalfLife;
+        bool autoRadius;
+    } rtefc {};
+    
+    struct
+    {
+        int k, window, refreshInterval, iterations;
+        float lengthWeight, refreshBudget;
+        bool warmStart;
+    } kmeans {};
+};
+
+// what the audio thread plays after each crossing, as the analysis side last chose it.
+// the audio is a copy, so the engines can go on rewriting their own storage while the
+// audio thread still reads this one
+struct PlaybackRepresentative
+{
+    juce::AudioBuffer<float> audio; // sized in prepareToPlay for the longest waveset
+    int numSamples = 0;             // 0: nothing to play, the input passes through
+    
+    WavesetHandle getHandle() const noexcept
+    {
+        WavesetHandle h;
+        h.numChannels = std::min(audio.getNumChannels(), WavesetHandle::maxChannels);
+        for (int ch = 0; ch < h.numChannels; ++ch)
+            h.channels[ch] = audio.getReadPointer(ch);
+        h.numSamples = numSamples;
+        return h;
+    }
+};
+
 //==============================================================================
 /**
 */
@@ -28,36 +91,36 @@ public:
     //==============================================================================
     RTWavesetsAudioProcessor();
     ~RTWavesetsAudioProcessor() override;
-
+    
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
-
+   
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
-
+   
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-
+    
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
-
+    
     //==============================================================================
     const juce::String getName() const override;
-
+    
     bool acceptsMidi() const override;
     bool producesMidi() const override;
     bool isMidiEffect() const override;
     double getTailLengthSeconds() const override;
-
+    
     //==============================================================================
     int getNumPrograms() override;
     int getCurrentProgram() override;
     void setCurrentProgram (int index) override;
     const juce::String getProgramName (int index) override;
     void changeProgramName (int index, const juce::String& newName) override;
-
+    
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
@@ -66,27 +129,202 @@ public:
     
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
     
-    RTEFC_Engine rtefcEngine;
-    KMeansWindowEngine kmeansEngine;
+    // third-order ambisonics, which also covers 7.1.4 and everything smaller
+    static constexpr int maxChannels = 16;
+    
+    // the editor shows one channel group at a time, the first unless it picks another
+    // (message thread). the getters return that group's engines, and only it publishes
+    // visualization snapshots; a group that stops being active falls back to the first
+    void setVisualizedGroup(int group) noexcept;
+    RTEFC_Engine& getRtefcEngine() noexcept;
+    KMeansWindowEngine& getKMeansEngine() noexcept;
+    
+    // the channels a group covers under the current linking, empty once it isn't active
+    int getNumActiveGroups() const noexcept { return numActiveGroups.load(std::memory_order_relaxed); }
+    juce::Range<int> getGroupChannels(int group) const noexcept;
+    int getVisualizedGroup() const noexcept;
+    
+    // processing time as a fraction of the audio's duration: all of processBlock per
+    // block, and the active engine per waveset of every channel group. realtime the
+    // engines run on the worker pool, and fall behind once their load passes 1
+    LoadHistogram blockLoad, rtefcLoad, kmeansLoad;
+    
+    // trades engine quality for cpu time when the engines run close to their deadline.
+    // every channel group reports its load here (under governorLock) and follows the
+    // level; each step is posted for the editor (the only reader)
+    QualityGovernor governor;
+    CommandQueue<QualityGovernor::Adjustment, 32> qualityAdjustments;
     
+    // what the parameters ask for, before the governor's reductions (any thread)
+    QualitySettings getRequestedQuality() const;
+
 private:
     //==============================================================================
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     
-    std::atomic<EngineMode> mode { EngineMode::RTEFC };
+    // one channel, or a linked pair, with its own segmentation, engines and playback.
+    // realtime, the audio thread only segments and plays. completed wavesets go through
+    // wavesetQueue to the group's analysis client on the shared worker pool, which owns
+    // the engines and publishes what to play next into representatives, read-copy-update
+    // style: the audio thread keeps reading its copy until it picks up a newer one at a
+    // crossing. every group has a client of its own, so independent channels are
+    // analysed in parallel. offline a group runs inline instead, so a render comes out
+    // the same every time (see processGroupsInParallel)
+    class ChannelGroup
+    {
+    public:
+        explicit ChannelGroup(RTWavesetsAudioProcessor& p) : processor(p) {}
+        
+        // while nothing else touches the group. numStorageChannels is the most it can be
+        // linked to: its buffers are sized for that, so relinking never allocates
+        void prepare(double sampleRate, int samplesPerBlock, int numStorageChannels);
+        
+        // audio thread
+        void setChannels(int first, int num) noexcept;
+        void process(juce::AudioBuffer<float>& buffer, int numSamples);
+        void resetPlayback() noexcept;
+        
+        // engine side
+        void drainCommands();
+        void applyCommand(const EngineCommand& command);
+        void applyCurrentParameters();
+        void serviceEngines(int numSamples); // refresh slices and visualization, per block or pass
+        
+        RTEFC_Engine rtefcEngine;
+        KMeansWindowEngine kmeansEngine;
+        WavesetSegmenter segmenter; // audio thread
+        
+        // parameter listeners post here; if it ever overflows the engine side resyncs
+        // from the parameter values
+        CommandQueue<EngineCommand, 256> commands;
+        std::atomic<bool> commandsDropped { false };
+        
+        // audio thread -> engine side: the group now covers other channels, start over.
+        // the reset parameters raise these too, from whichever thread pressed them
+        std::atomic<bool> resetAllRequested { false };
+        std::atomic<bool> resetClustersRequested { false };
+        
+        // offline: a block for whichever thread claims it first
+        std::atomic<bool> blockPending { false };
+        
+        class AnalysisClient : public WorkerPool::Client
+        {
+        public:
+            explicit AnalysisClient(ChannelGroup& g) : group(g) {}
+            bool service() override;
+        
+        private:
+            ChannelGroup& group;
+        };
+        
+        AnalysisClient analysisClient { *this };
+    
+    private:
+        RTWavesetsAudioProcessor& processor;
+        
+        int firstChannel = 0, numChannels = 1; // audio thread
+        
+        WavesetQueue wavesetQueue;
+        TripleBuffer<PlaybackRepresentative> representatives;
+        
+        // engine side
+        EngineMode mode = EngineMode::RTEFC;
+        
+        // the engines' parameters as last requested; they get them with the governor's
+        // reductions applied, and again whenever its level changes
+        decltype(EngineCommand::rtefc) requestedRtefc {};
+        decltype(EngineCommand::kmeans) requestedKMeans {};
+        int appliedQualityLevel = 0;
+        void applyRtefcParameters();
+        void applyKMeansParameters();
+        void followGovernor(); // re-applies both if the governor's level moved on
+        
+        juce::AudioBuffer<float> analysisWaveset; // popped from the queue, room for the longest one
+        WavesetHandle lastPublished;              // skips copying the same representative again
+        void analyseWaveset(const juce::AudioBuffer<float>& waveset);
+        bool analyseQueued(); // one slice's worth; false if nothing was queued
+        void publishRepresentative(const WavesetHandle& rep);
+        void clearRepresentative(); // after a reset: stop playing, pass the input through
+        int samplesSinceVisualization = 0;
+        
+        float prevRadius = 1.5f;
+        float prevLengthWeight = 5.0f;
+        
+        // representative currently playing (audio thread), out of representatives' read buffer
+        WavesetHandle currentOutputWaveset;
+        int outputPeriodLength = 0; // representative plus trailing silence, in samples
+        int outputReadPosition = 0;
+        bool isFirstWavesetProcessed = false;
+        void adoptRepresentative(); // at each crossing
+        
+        // plays the current representative into [startSample, endSample) of the block
+        void renderOutput(juce::AudioBuffer<float>& buffer, int startSample, int endSample);
+        
+        JUCE_DECLARE_NON_COPYABLE (ChannelGroup)
+    };
+    
+    // created as prepareToPlay first needs them and kept until the processor goes, so
+    // anything below numGroups stays valid from any thread
+    std::array<std::unique_ptr<ChannelGroup>, (size_t) maxChannels> groups;
+    std::atomic<int> numGroups { 0 };
+    
+    int numChannels = 2;                    // set in prepareToPlay
+    std::atomic<int> numActiveGroups { 1 }; // changed by the audio thread only, with the grouping
+    std::atomic<int> activeGroupSize { 2 }, numGroupedChannels { 2 }; // the same, for the editor
+    std::atomic<int> visualizedGroup { 0 };
+    ChannelLinking linking = ChannelLinking::pairs;
+    void setLinking(ChannelLinking newLinking, bool resetEngines);
+    
+    // parameter listeners post here. segmentation and linking commands go to the audio
+    // thread, all others to every group (see postCommand). if a queue ever overflows,
+    // its consumer resyncs from the parameter values
+    CommandQueue<EngineCommand, 32> audioThreadCommands;
+    std::atomic<bool> audioThreadCommandsDropped { false };
+    
+    void postCommand(const EngineCommand& command);
+    void drainAudioThreadCommands();
+    void applyAudioThreadCommand(const EngineCommand& command);
+    
+    // read the parameters' current values into a command for their group
+    EngineCommand makeModeCommand() const;
+    EngineCommand makeSegmentationCommand() const;
+    EngineCommand makeLinkingCommand() const;
+    EngineCommand makeRtefcCommand() const;
+    EngineCommand makeKMeansCommand() const;
+    EngineCommand makeGovernorCommand() const;
+    
+    // engine side, from any group
+    juce::SpinLock governorLock;
+    bool governorEnabled = true;
+    int governorSamples = 0; // a share of the audio, carried over between wavesets
+    void updateGovernor(float load, int numSamples);
+    void setGovernorEnabled(bool shouldBeEnabled);
+    
+    static constexpr double queueSeconds = 4.0;
+    static constexpr int maxQueuedWavesets = 4096;
+    static constexpr double analysisSliceSeconds = 0.02; // audio analysed per slice, at most
+    int analysisSliceSamples = 0;
+    bool analyseInline = false; // set in prepareToPlay, while no client is in the pool
+    
+    juce::SharedResourcePointer<WorkerPool> workerPool;
     
-    juce::AudioBuffer<float> inputAssemblyBuffer;
-    int inputAssemblyBufferWritePosition = 0;
+    // offline with more than one group: each group's block goes to whichever comes first,
+    // the group's client on the pool or the processing thread, which waits for the rest.
+    // groups share no state, so the render is the same as doing them one after another
+    juce::AudioBuffer<float>* parallelBuffer = nullptr;
+    int parallelNumSamples = 0;
+    std::atomic<int> groupsDone { 0 };
+    void processGroupsInParallel(juce::AudioBuffer<float>& buffer, int numSamples);
+    bool runPendingBlock(ChannelGroup& group);
     
-    juce::AudioBuffer<float> currentOutputWaveset;
-    int outputReadPosition = 0;
-    int lastSign = 0;
-    bool isFirstWavesetProcessed = false;
+    // the first group publishes a visualization snapshot at most this often
+    static constexpr double visualizationRateHz = 30.0;
+    int visualizationIntervalSamples = 0;
     
-    juce::AudioBuffer<float> scratchWaveset;
+    double ticksPerSample = 0.0; // high resolution clock ticks per sample at the current rate
     
-    float prevRadius = 1.5f;
-    float prevLengthWeight = 5.0f;
+    static constexpr int realtimeWarmUpBlocks = 8;
+    int blocksSincePrepare = 0;
     
     //==============================================================================
     
@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.cpp
+    Created: 17 Oct 2026 4:52:10am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "QualityGovernor.h"
+
+void QualityGovernor::prepare(double sampleRate)
+{
+    windowSamples = std::max(1, (int) std::round(sampleRate * windowSeconds));
+    reset();
+}
+
+void QualityGovernor::reset() noexcept
+{
+    samplesInWindow = 0;
+    blocksInWindow = 0;
+    windowPeak = 0.0f;
+    windowSum = 0.0;
+    calmWindows = 0;
+    settling = false;
+    level.store(0);
+}
+
+bool QualityGovernor::update(float blockLoad, int numSamples, Adjustment& adjustment) noexcept
+{
+    samplesInWindow += numSamples;
+    ++blocksInWindow;
+    windowPeak = std::max(windowPeak, blockLoad);
+    windowSum += blockLoad;
+    
+    if (samplesInWindow < windowSamples)
+        return false;
+    
+    const float peak = windowPeak;
+    const float mean = (float) (windowSum / blocksInWindow);
+    const bool wasSettling = settling;
+    samplesInWindow = 0;
+    blocksInWindow = 0;
+    windowPeak = 0.0f;
+    windowSum = 0.0;
+    settling = false;
+    
+    if (wasSettling)
+        return false;
+    
+    const int current = level.load(std::memory_order_relaxed);
+    int next = current;
+    
+    if (peak > highPeakLoad || mean > highMeanLoad)
+    {
+        calmWindows = 0;
+        next = std::min(maxLevel, current + 1);
+    }
+    else if (peak < lowPeakLoad)
+    {
+        if (++calmWindows >= restoreAfterCalmWindows)
+        {
+            calmWindows = 0;
+            next = std::max(0, current - 1);
+        }
+    }
+    else
+    {
+        calmWindows = 0;
+    }
+    
+    if (next == current)
+        return false;
+    
+    level.store(next, std::memory_order_relaxed);
+    settling = true;
+    adjustment = { current, next, peak, juce::Time::getMillisecondCounter() };
+    return true;
+}
+
+QualitySettings QualityGovernor::apply(const QualitySettings& requested, int atLevel) noexcept
+{
+    const int l = juce::jlimit(0, maxLevel, atLevel);
+    auto s = requested;
+    
+    // cheapest first: fewer Lloyd passes and rarer refreshes barely change what plays,
+    // fewer clusters do, so those only start going from level 2
+    s.kmIterations = std::max(1, requested.kmIterations - l);
+    s.kmRefreshInterval = juce::roundToInt((float) requested.kmRefreshInterval * (1.0f + 0.5f * (float) l));
+    
+    const float clusterScale = 1.0f - 0.15f * (float) std::max(0, l - 1);
+    s.kmK = std::max(2, juce::roundToInt((float) requested.kmK * clusterScale));
+    s.rtefcMaxClusters = std::max(1.0f, requested.rtefcMaxClusters * clusterScale);
+    return s;
+}
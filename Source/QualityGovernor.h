@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+    Created: 17 Oct 2026 4:52:10am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+// the engine settings the governor trades for cpu time
+struct QualitySettings
+{
+    int kmK = 8;
+    int kmIterations = 3;
+    int kmRefreshInterval = 32;
+    float rtefcMaxClusters = 30.0f;
+};
+
+// steps the engines' quality down while their measured load runs close to the
+// deadline, and back up once there is headroom again. load is judged over half-second
+// windows of audio: a window whose peak (or mean) crosses the high mark costs one level, a few
+// calm windows in a row give one back
+class QualityGovernor
+{
+public:
+    static constexpr int maxLevel = 4;
+    
+    // one step, as reported to the editor
+    struct Adjustment
+    {
+        int fromLevel = 0, toLevel = 0;
+        float load = 0.0f; // peak block load of the window that caused it
+        juce::uint32 timeMs = 0; // juce::Time::getMillisecondCounter() when it happened
+    };
+    
+    // while the audio thread is stopped; starts at full quality
+    void prepare(double sampleRate);
+    void reset() noexcept;
+    
+    // engine side, once per block or waveset of numSamples. true when the level changed,
+    // described in adjustment
+    bool update(float blockLoad, int numSamples, Adjustment& adjustment) noexcept;
+    
+    // any thread; 0 is full quality
+    int getLevel() const noexcept { return level.load(std::memory_order_relaxed); }
+    
+    // what the engines run with at a level, given what the parameters ask for
+    static QualitySettings apply(const QualitySettings& requested, int level) noexcept;
+
+private:
+    static constexpr double windowSeconds = 0.5;
+    static constexpr float highPeakLoad = 0.8f;
+    static constexpr float highMeanLoad = 0.6f;
+    static constexpr float lowPeakLoad = 0.45f;
+    static constexpr int restoreAfterCalmWindows = 4;
+    
+    int windowSamples = 22050;
+    int samplesInWindow = 0;
+    int blocksInWindow = 0;
+    float windowPeak = 0.0f;
+    double windowSum = 0.0;
+    int calmWindows = 0;
+    
+    // the window right after a change pays for the switch (a cold k-means restart), so it
+    // isn't judged
+    bool settling = false;
+    
+    std::atomic<int> level { 0 };
+};
@@ -9,15 +9,31 @@
 */
 
 #include "RTEFC_Engine.h"
+#include "RealtimeGuard.h"
 
 // ===========================================================
 RTEFC_Engine::RTEFC_Engine()
 {
+    // levels span decades, so compare them on a log scale
+    for (int d = 0; d < featureDimension; ++d)
+        clusters.setLogarithmic(d, isLevelDescriptor(WavesetFeatures::descriptors[(size_t) d]));
+    
     resetAll();
 }
 
-void RTEFC_Engine::prepare(double sampleRate)
+void RTEFC_Engine::prepare(double sampleRate, int numChannels)
 {
+    // arena holds at least one waveset of the longest length the processor can assemble,
+    // and grows with the cluster cap in setParameters, so spawning clusters never allocates
+    maxWavesetLength = std::max(1, (int) std::round(sampleRate * 2.0));
+    arenaSampleRate = sampleRate;
+    arena.setSize(juce::jlimit(1, WavesetHandle::maxChannels, numChannels), getArenaSize(maxClusters.load()));
+    arena.clear();
+    
+    clusters.allocate(maxClusterSlots);
+    centroidIndex.allocate(maxClusterSlots);
+    recentPoints.reserve(maxRecentPoints + 1);
+    
     resetAll();
 }
 
@@ -25,26 +41,22 @@ void RTEFC_Engine::resetAll()
 {
     // reset online normalizer state
     wavesetCount = 0;
-    lengthMean = rmsMean = 0.0;
-    lengthVarEma = rmsVarEma = 1.0;
+    featureMean.fill(0.0);
+    featureVarEma.fill(1.0);
+    residualVarEma.fill(1.0f);
+    clusters.resetAxisSpread();
     distanceEma = 0.0f;
     resetClustersOnly();
 }
 
 void RTEFC_Engine::resetClustersOnly()
 {
-    // clear matrices and waveset buffer
-    centroids.clear();
-    representatives.clear();
-    lastChosenWaveset.setSize(0, 0);
-    reserveForMaxClusters();
-}
-
-void RTEFC_Engine::reserveForMaxClusters()
-{
-    const int cap = (int) std::max(8.0f, maxClusters.load());
-    centroids.reserve((size_t) cap);
-    representatives.reserve((size_t) cap);
+    // clear matrices and rewind the arena (storage itself is kept)
+    clusters.clear();
+    centroidIndex.clear();
+    arenaWritePosition = 0;
+    lastChosenWaveset = {};
+    ++storageGeneration;
 }
 
 void RTEFC_Engine::setParameters(float newRadius, float newAlpha, float newLenWeight, float newMaxClusters, float newNormHalfLifeWavesets, bool newAutoRadius)
@@ -55,28 +67,34 @@ void RTEFC_Engine::setParameters(float newRadius, float newAlpha, float newLenWe
     maxClusters.store(newMaxClusters);
     autoRadius.store(newAutoRadius);
     
+    // a lower cap keeps the room it has, until the next prepare
+    const int arenaSize = getArenaSize(newMaxClusters);
+    if (arena.getNumChannels() > 0 && arenaSize > arena.getNumSamples())
+        growArena(arenaSize);
+    
     if (newNormHalfLifeWavesets > 1.f && newNormHalfLifeWavesets != normHalfLifeWavesets) {
         normHalfLifeWavesets = newNormHalfLifeWavesets;
         beta = kLn2 / normHalfLifeWavesets;
         beta = juce::jlimit(0.001f, 0.5f, beta);
     }
-    
-    reserveForMaxClusters();
 }
 
-const juce::AudioBuffer<float>& RTEFC_Engine::processWaveset(const juce::AudioBuffer<float> &newWaveset)
+WavesetHandle RTEFC_Engine::processWaveset(const juce::AudioBuffer<float> &newWaveset)
 {
+    RTWAVESETS_REALTIME_SITE("RTEFC_Engine::processWaveset");
+    
     if (newWaveset.getNumSamples() <= 0 || newWaveset.getNumChannels() <= 0)
         return lastChosenWaveset;
     
-    // waveset length & rms feature extraction
+    // waveset feature extraction
     auto raw = extractFeatures(newWaveset);
     
     wavesetCount++;
-    emaUpdate(raw[0], beta, lengthMean, lengthVarEma);
-    emaUpdate(raw[1], beta, rmsMean,    rmsVarEma);
+    for (size_t d = 0; d < raw.size(); ++d)
+        emaUpdate(raw[d], beta, featureMean[d], featureVarEma[d]);
     
-    auto features = getNormalizedFeatures(raw);
+    updateNormalization();
+    auto features = clusters.normalize(raw);
     
     lastProcessedFeatures = features;
     recentPoints.push_back(features);
@@ -84,42 +102,19 @@ const juce::AudioBuffer<float>& RTEFC_Engine::processWaveset(const juce::AudioBu
         recentPoints.erase(recentPoints.begin());
     
     // RTEFC algorithm
-    if (centroids.empty())
+    if (clusters.empty())
     {
         // first waveset, becomes first centroid
-        centroids.push_back(features);
-        representatives.emplace_back();
-        representatives.back().makeCopyOf(newWaveset);
-        lastChosenWaveset = representatives.back();
+        if (addCluster(features, newWaveset))
+            chooseRepresentative(clusters.size() - 1);
         return lastChosenWaveset;
     }
     
-    if (centroids.size() != representatives.size())
-    {
-        const size_t n = std::min(centroids.size(), representatives.size());
-        centroids.resize(n);
-        representatives.resize(n);
-        if (n == 0)
-        {
-            centroids.push_back(features);
-            representatives.emplace_back();
-            representatives.back().makeCopyOf(newWaveset);
-            lastChosenWaveset = representatives.back();
-            return lastChosenWaveset;
-        }
-    }
-    
     // find closest existing centroid
     float d_close = 0.0f;
     const int closest_idx = findClosestCentroid(features, d_close);
-    if (closest_idx < 0 || closest_idx >= (int)centroids.size())
-   {
-       centroids.push_back(features);
-       representatives.emplace_back();
-       representatives.back().makeCopyOf(newWaveset);
-       lastChosenWaveset = representatives.back();
-       return lastChosenWaveset;
-   }
+    if (closest_idx < 0 || closest_idx >= clusters.size())
+        return lastChosenWaveset;
     
     distanceEma = (1.0f - distanceEmaBeta) * distanceEma + distanceEmaBeta * d_close;
     
@@ -127,47 +122,45 @@ const juce::AudioBuffer<float>& RTEFC_Engine::processWaveset(const juce::AudioBu
     if (autoRadius.load() && distanceEma > 0.0f)
         radiusEff = std::max(radiusEff, 1.25f * distanceEma);
     
-    const bool haveRoom = (int)centroids.size() < (int)maxClusters.load();
+    const int clusterCap = std::min(maxClusterSlots, (int) maxClusters.load());
+    const bool haveRoom = clusters.size() < clusterCap;
     
     // if new case is novel, and we have room to look for more clusters...
-    if (d_close > radiusEff && haveRoom)
+    // (add s_new as new centroid, new waveset becomes representative for this cluster)
+    if (d_close > radiusEff && haveRoom && addCluster(features, newWaveset))
     {
-        // add s_new as new centroid
-        centroids.push_back(features);
-        
-        // new waveset becomes representative for this cluster
-        representatives.emplace_back();
-        representatives.back().makeCopyOf(newWaveset);
-        lastChosenWaveset = representatives.back();
+        chooseRepresentative(clusters.size() - 1);
     }
     else
     {
         // otherwise, we just update the closest existing centroid with exponential filtering
-        auto& s_close = centroids[(size_t) closest_idx];
-        DBG("now playing: " << centroids[closest_idx][0]);
-        const float a = alpha.load();
-        for (size_t i = 0; i < s_close.size(); ++i)
-            s_close[i] = a * s_close[i] + (1.0f - a) * features[i];
+        auto s_close = clusters.getCentroid(closest_idx);
         
-        // use representative waveset of closest cluster
-        if ((size_t)closest_idx < representatives.size())
-            lastChosenWaveset = representatives[(size_t) closest_idx];
-        else
+        if constexpr (Space::adaptiveMetric)
         {
-            const size_t n = std::min(centroids.size(), representatives.size());
-            centroids.resize(n);
-            representatives.resize(n);
-            if (n == 0)
+            // the residual before the update tells how wide the cluster is along each axis
+            FeatureVector spread;
+            for (size_t i = 0; i < s_close.size(); ++i)
             {
-                centroids.push_back(features);
-                representatives.emplace_back();
+                const float r2 = juce::square((features[i] - s_close[i]) / clusters.getAxisWeight((int) i));
+                residualVarEma[i] = (1.0f - beta) * residualVarEma[i] + beta * r2;
+                spread[i] = residualVarEma[i];
             }
-            representatives.back().makeCopyOf(newWaveset);
-            lastChosenWaveset = representatives.back();
+            clusters.setAxisSpread(spread);
         }
         
+        const float a = alpha.load();
+        for (size_t i = 0; i < s_close.size(); ++i)
+            s_close[i] = a * s_close[i] + (1.0f - a) * features[i];
+        clusters.setCentroid(closest_idx, s_close);
+        centroidIndex.move(closest_idx, s_close);
+        
+        // use representative waveset of closest cluster
+        chooseRepresentative(closest_idx);
     }
     
+    updateIndexCellSize(radiusEff);
+    
     return lastChosenWaveset;
 }
 
@@ -175,64 +168,145 @@ const juce::AudioBuffer<float>& RTEFC_Engine::processWaveset(const juce::AudioBu
 // private helper methods
 // =============================================
 
-std::array<float,2> RTEFC_Engine::extractFeatures(const juce::AudioBuffer<float> &waveset) const
+int RTEFC_Engine::getArenaSize(float clusterCap) const noexcept
 {
-    float length = static_cast<float>(waveset.getNumSamples());
-    // feature extraction is only left channel for now
-    float rms = waveset.getRMSLevel(0, 0, waveset.getNumSamples());
-    return { length, rms };
+    const double seconds = juce::jlimit(1.0, (double) maxClusterSlots, (double) clusterCap) * arenaSecondsPerCluster;
+    const int size = (int) std::round(arenaSampleRate * std::min(seconds, maxArenaSeconds));
+    return std::max(maxWavesetLength, size);
 }
 
-std::array<float,2> RTEFC_Engine::getNormalizedFeatures(const std::array<float,2> &raw) const
+void RTEFC_Engine::growArena(int newSize)
 {
-    // compute std from EMA variances with caution to avoid divide-by-0
-    const double lenStd = std::sqrt(std::max(1e-10, lengthVarEma));
-    const double rmsStd = std::sqrt(std::max(1e-10, rmsVarEma));
+    // the representatives keep their offsets but not their addresses
+    const bool hadChosen = ! lastChosenWaveset.isEmpty();
+    const int chosenOffset = hadChosen ? (int) (lastChosenWaveset.channels[0] - arena.getReadPointer(0)) : 0;
+    
+    arena.setSize(arena.getNumChannels(), newSize, true, true);
+    ++storageGeneration;
+    
+    if (hadChosen)
+    {
+        for (int ch = 0; ch < lastChosenWaveset.numChannels; ++ch)
+            lastChosenWaveset.channels[ch] = arena.getReadPointer(ch, chosenOffset);
+        lastChosenWaveset.generation = storageGeneration.load();
+    }
+}
 
-    float f0 = (float)((raw[0] - lengthMean) / lenStd);
-    const double logR = std::log(std::max(1e-6f, raw[1]));
-    const double logRmean = std::log(std::max(1e-6, rmsMean));
-    float f1 = (float)((logR - logRmean) / std::max(1e-6, rmsStd));
+bool RTEFC_Engine::addCluster(const FeatureVector& features, const juce::AudioBuffer<float>& waveset)
+{
+    const int length = std::min(waveset.getNumSamples(), maxWavesetLength);
+    if (length <= 0
+        || clusters.size() >= maxClusterSlots
+        || arenaWritePosition + length > arena.getNumSamples())
+        return false;
+    
+    // representatives never move once written, so slots are packed back to back
+    for (int ch = 0; ch < arena.getNumChannels(); ++ch)
+    {
+        const int srcCh = std::min(ch, waveset.getNumChannels() - 1);
+        arena.copyFrom(ch, arenaWritePosition, waveset, srcCh, 0, length);
+    }
+    
+    if (! clusters.add(features, { arenaWritePosition, length }))
+        return false;
+    
+    centroidIndex.insert(clusters.size() - 1, features);
+    arenaWritePosition += length;
+    return true;
+}
 
-    f0 *= weight.load();
+void RTEFC_Engine::chooseRepresentative(int clusterIndex)
+{
+    if (clusterIndex < 0 || clusterIndex >= clusters.size())
+        return;
+    
+    // slots are never overwritten until the arena is rewound, so the handle stays valid until then
+    const auto& slot = clusters.getRepresentative(clusterIndex);
+    lastChosenWaveset.numChannels = std::min(arena.getNumChannels(), WavesetHandle::maxChannels);
+    for (int ch = 0; ch < lastChosenWaveset.numChannels; ++ch)
+        lastChosenWaveset.channels[ch] = arena.getReadPointer(ch, slot.offset);
+    lastChosenWaveset.numSamples = slot.length;
+    lastChosenWaveset.generation = storageGeneration.load();
+}
 
-    return { f0, f1 };
+FeatureVector RTEFC_Engine::extractFeatures(const juce::AudioBuffer<float> &waveset) const
+{
+    return WavesetFeatures::select(WavesetAnalyser::analyse(waveset));
 }
 
-int RTEFC_Engine::findClosestCentroid(const std::array<float,2> &features, float &distanceFound) const
+void RTEFC_Engine::updateNormalization()
 {
-    int closestIndex = -1;
-    float minDistanceSq = std::numeric_limits<float>::max();
-    
-    for (size_t i = 0; i < centroids.size(); ++i)
+    FeatureVector centre, spread;
+    for (int d = 0; d < featureDimension; ++d)
     {
-        const auto& c = centroids[i];
-        const float dx = features[0] - c[0];
-        const float dy = features[1] - c[1];
-        const float d2 = dx*dx + dy*dy;
-
-        if (d2 < minDistanceSq)
+        const auto i = (size_t) d;
+        
+        // compute std from EMA variances with caution to avoid divide-by-0
+        const double sd = std::sqrt(std::max(1e-10, featureVarEma[i]));
+        
+        if (clusters.isLogarithmic(d))
+        {
+            centre[i] = (float) std::log(std::max(1e-6, featureMean[i]));
+            spread[i] = (float) std::max(1e-6, sd);
+        }
+        else
         {
-            minDistanceSq = d2;
-            closestIndex = (int) i;
+            centre[i] = (float) featureMean[i];
+            spread[i] = (float) sd;
         }
     }
     
-    distanceFound = std::sqrt(std::max(0.0f, minDistanceSq));
-    return closestIndex;
+    clusters.setNormalization(centre, spread);
+    clusters.setAxisWeight(0, weight.load());
 }
 
-std::vector<std::array<float,2>> RTEFC_Engine::getVisualizationCentroids() const
+int RTEFC_Engine::findClosestCentroid(const FeatureVector &features, float &distanceFound) const
 {
-    return centroids;
+    const auto& centroids = clusters.getCentroids();
+    float minCost = 0.0f;
+    int closestIndex = -1;
+    
+    if (centroids.size() >= gridMinClusters)
+        closestIndex = centroidIndex.nearest(features, centroids, minCost);
+    
+    // few clusters, or nothing close enough for the grid to vouch for
+    if (closestIndex < 0)
+        closestIndex = centroids.nearest(features, minCost);
+    
+    distanceFound = Metric::toDistance(minCost);
+    return closestIndex;
 }
 
-std::vector<std::array<float,2>> RTEFC_Engine::getRecentPoints() const
+void RTEFC_Engine::updateIndexCellSize(float radiusEff) noexcept
 {
-    return recentPoints;
+    // clusters spawn about a radius apart, so radius-sized cells keep a handful of
+    // centroids per cell. only re-index when the radius has drifted well away
+    const float ratio = radiusEff / centroidIndex.getCellSize();
+    if (ratio < 0.5f || ratio > 2.0f)
+        centroidIndex.rebuild(radiusEff, clusters.getCentroids());
 }
 
-std::optional<std::array<float,2>> RTEFC_Engine::getCurrentPoint() const
+void RTEFC_Engine::publishVisualization()
 {
-    return lastProcessedFeatures;
+    RTWAVESETS_REALTIME_SITE("RTEFC_Engine::publishVisualization");
+    auto& snap = visualization.getWriteBuffer();
+    
+    snap.numCentroids = std::min(clusters.size(), VisualizationSnapshot::maxCentroids);
+    for (int i = 0; i < snap.numCentroids; ++i)
+        snap.centroids[(size_t) i] = VisualizationSnapshot::project(clusters.getCentroid(i));
+    
+    snap.numPoints = std::min((int) recentPoints.size(), VisualizationSnapshot::maxPoints);
+    for (int i = 0; i < snap.numPoints; ++i)
+        snap.points[(size_t) i] = VisualizationSnapshot::project(recentPoints[(size_t) i]);
+    std::fill_n(snap.assignments.begin(), snap.numPoints, -1);
+    
+    snap.hasCurrentPoint = lastProcessedFeatures.has_value();
+    if (snap.hasCurrentPoint)
+        snap.currentPoint = VisualizationSnapshot::project(*lastProcessedFeatures);
+    
+    snap.distanceEma = distanceEma;
+    visualization.publish();
+    
+    publishedNumClusters.store(clusters.size());
+    publishedDistanceEma.store(distanceEma);
 }
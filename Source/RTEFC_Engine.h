@@ -11,6 +11,12 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "WavesetHandle.h"
+#include "TripleBuffer.h"
+#include "VisualizationSnapshot.h"
+#include "ClusterSpace.h"
+#include "CentroidGrid.h"
+#include "WavesetFeatures.h"
 #include <vector>
 #include <array>
 #include <limits>
@@ -21,38 +27,82 @@ public:
     // ===========================================================
     RTEFC_Engine();
     
-    void prepare(double sampleRate);
+    // numChannels of representative storage, 1 or 2 (channel groups of the processor).
+    // the arena starts out sized for the current cluster cap
+    void prepare(double sampleRate, int numChannels = WavesetHandle::maxChannels);
     
     void resetAll();          // hard reset: stats + clusters
     void resetClustersOnly(); // soft reset, no stats
 
     // takes waveset and returns the chosen representative from its cluster
-    const juce::AudioBuffer<float>& processWaveset(const juce::AudioBuffer<float>& newWaveset);
+    WavesetHandle processWaveset(const juce::AudioBuffer<float>& newWaveset);
     
-    // called from processor
+    // bumped whenever the arena is rewound or grown, invalidating every handle handed out before
+    juce::uint32 getStorageGeneration() const noexcept { return storageGeneration.load(); }
+    
+    // engine side, never the audio thread: raising the cluster cap past what the arena
+    // was sized for grows it (the processor hands parameter changes over through its
+    // command queues)
     void setParameters(float newRadius, float newAlpha, float newWeight, float newMaxClusters, float newNormHalfLifeWavesets, bool newAutoRadius);
     
-    int getNumClusters() const noexcept { return (int) centroids.size(); }
-    float getDistanceEMA() const noexcept { return distanceEma; }
+    // telemetry, safe from any thread (updated when visualization is published)
+    int getNumClusters() const noexcept { return publishedNumClusters.load(); }
+    float getDistanceEMA() const noexcept { return publishedDistanceEma.load(); }
+    
+    // audio thread: copies the current state into the snapshot channel
+    void publishVisualization();
     
-    std::vector<std::array<float,2>> getVisualizationCentroids() const;
-    std::vector<std::array<float,2>> getRecentPoints() const;
-    std::optional<std::array<float,2>> getCurrentPoint() const;
+    // message thread (single reader): picks up the newest snapshot, false if nothing changed
+    bool acquireVisualization() noexcept { return visualization.acquire(); }
+    const VisualizationSnapshot& getVisualization() const noexcept { return visualization.getReadBuffer(); }
     
 private:
     // ===========================================================
-    // feature (centroids) vector matrix S
-    std::vector<std::array<float,2>> centroids;
-    
-    // representative audio wavesets for each cluster
-    std::vector<juce::AudioBuffer<float>> representatives;
-    
-    // waveset history
-    juce::AudioBuffer<float> lastChosenWaveset;
-    
-    // real-time normalization params with EMA
-    double lengthMean{0.0}, lengthVarEma{1.0};
-    double rmsMean{0.0},    rmsVarEma{1.0};
+    // representative audio wavesets for each cluster, stored as slots in the arena
+    struct RepresentativeSlot
+    {
+        int offset = 0;
+        int length = 0;
+    };
+    
+    // how far a waveset is from a cluster; radius and distanceEma are in its units
+    using Metric = WeightedEuclidean;
+    
+    // feature (centroids) vector matrix S, plus one representative slot per cluster
+    using Space = ClusterSpace<featureDimension, Metric, RepresentativeSlot>;
+    Space clusters;
+    
+    // spatial index over the centroids; a plain SIMD scan is faster below gridMinClusters
+    CentroidGrid<featureDimension, Metric> centroidIndex;
+    static constexpr int gridMinClusters = 64;
+    void updateIndexCellSize(float radiusEff) noexcept;
+    
+    // preallocated sample storage for all representatives. it is an audio budget of
+    // arenaSecondsPerCluster per cluster the cap allows, between one longest waveset and
+    // maxArenaSeconds, so short wavesets leave room for more clusters than that and the
+    // default cap costs a couple of seconds of audio; once it is full, new clusters
+    // simply stop spawning. the centroid slots are small, so they cover the whole range
+    static constexpr int maxClusterSlots = 4096; // upper end of the clusters_per_second range
+    static constexpr double arenaSecondsPerCluster = 0.02; // one period at 50 Hz
+    static constexpr double maxArenaSeconds = 60.0;
+    juce::AudioBuffer<float> arena;
+    int arenaWritePosition = 0;
+    int maxWavesetLength = 0;
+    double arenaSampleRate = 44100.0;
+    int getArenaSize(float clusterCap) const noexcept;
+    void growArena(int newSize); // keeps every representative written so far
+    
+    std::atomic<juce::uint32> storageGeneration { 1 };
+    
+    // waveset history (non-owning view into the arena)
+    WavesetHandle lastChosenWaveset;
+    
+    // real-time normalization params with EMA, one pair per feature
+    std::array<double, (size_t) featureDimension> featureMean {}, featureVarEma {};
+    void updateNormalization();
+    
+    // within-cluster variance per axis (standardized units), for adaptive metrics
+    FeatureVector residualVarEma {};
     long long wavesetCount{0};
     
     float normHalfLifeWavesets{64.f};
@@ -70,8 +120,8 @@ private:
     float distanceEmaBeta{0.05f};
     
     // helper methods
-    // calculates waveset length & rms features for a single waveset
-    std::array<float,2> extractFeatures(const juce::AudioBuffer<float>& waveset) const;
+    // calculates the WavesetFeatures of a single waveset
+    FeatureVector extractFeatures(const juce::AudioBuffer<float>& waveset) const;
     
     static inline void emaUpdate(double x, float b, double& mean, double& varEma)
     {
@@ -80,17 +130,22 @@ private:
         varEma = (1.0 - b) * varEma + b * (diff * diff);
     }
     
-    // uses running stats to normalize raw features
-    std::array<float,2> getNormalizedFeatures(const std::array<float,2>& raw) const;
-    
     // finds index of closest centroid to given feature vector
-    int findClosestCentroid(const std::array<float,2>& features, float& distanceFound) const;
+    int findClosestCentroid(const FeatureVector& features, float& distanceFound) const;
     
-    void reserveForMaxClusters();
+    // copies waveset into the arena and adds it as a new cluster, false if out of room
+    bool addCluster(const FeatureVector& features, const juce::AudioBuffer<float>& waveset);
     
-    std::vector<std::array<float,2>> recentPoints;
-    std::optional<std::array<float,2>> lastProcessedFeatures;
+    // points lastChosenWaveset at a representative slot without copying
+    void chooseRepresentative(int clusterIndex);
+    
+    std::vector<FeatureVector> recentPoints;
+    std::optional<FeatureVector> lastProcessedFeatures;
     static const size_t maxRecentPoints = 50;
     
+    TripleBuffer<VisualizationSnapshot> visualization;
+    std::atomic<int> publishedNumClusters { 0 };
+    std::atomic<float> publishedDistanceEma { 0.0f };
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RTEFC_Engine)
 };
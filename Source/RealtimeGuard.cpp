@@ -0,0 +1,310 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.cpp
+    Created: 16 Oct 2026 11:40:52pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "RealtimeGuard.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if RTWAVESETS_REALTIME_CHECKS && (JUCE_LINUX || JUCE_BSD || JUCE_MAC)
+ #define RTWAVESETS_REALTIME_CHECKS_LOCKS 1
+ #include <dlfcn.h>
+ #include <pthread.h>
+#else
+ #define RTWAVESETS_REALTIME_CHECKS_LOCKS 0
+#endif
+
+#if RTWAVESETS_REALTIME_CHECKS && JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace
+{
+    enum class Event { allocation, free, lock };
+    
+    // per thread, constant-initialised, so it's safe to touch from inside operator new
+    struct ThreadState
+    {
+        int depth = 0;
+        const char* site = nullptr;
+        bool armed = false;
+        bool recording = false; // guards against the bookkeeping reporting itself
+    };
+    
+    thread_local ThreadState threadState;
+    
+    // sites are keyed by the label's address; the table only ever grows, so lookups
+    // are lock-free and nothing here allocates
+    struct SiteCounters
+    {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<juce::uint64> allocations { 0 }, bytes { 0 }, frees { 0 }, locks { 0 }, tolerated { 0 };
+    };
+    
+    constexpr int maxSites = 64;
+    SiteCounters sites[maxSites];
+    std::atomic<bool> trapping { false };
+    
+   #if RTWAVESETS_REALTIME_CHECKS
+    SiteCounters* findSite(const char* name) noexcept
+    {
+        for (auto& s : sites)
+        {
+            const char* existing = s.name.load(std::memory_order_acquire);
+            if (existing == nullptr && s.name.compare_exchange_strong(existing, name, std::memory_order_acq_rel))
+                return &s;
+            if (existing == name)
+                return &s;
+        }
+        return nullptr; // table full, drop it
+    }
+    
+    const char* describe(Event e) noexcept
+    {
+        switch (e)
+        {
+            case Event::allocation: return "heap allocation";
+            case Event::free:       return "heap free";
+            case Event::lock:       return "mutex lock";
+        }
+        return "";
+    }
+    
+    void record(Event e, size_t size) noexcept
+    {
+        auto& t = threadState;
+        if (t.depth == 0 || t.recording)
+            return;
+        
+        t.recording = true;
+        if (auto* s = findSite(t.site))
+        {
+            if (! t.armed)
+                ++s->tolerated;
+            else if (e == Event::allocation)
+                { ++s->allocations; s->bytes += size; }
+            else if (e == Event::free)
+                ++s->frees;
+            else
+                ++s->locks;
+        }
+        
+        if (t.armed && trapping.load(std::memory_order_relaxed))
+        {
+            std::fprintf(stderr, "real-time violation: %s in %s\n", describe(e), t.site);
+            std::abort();
+        }
+        t.recording = false;
+    }
+   #endif
+}
+
+//==============================================================================
+RealtimeGuard::Scope::Scope(const char* site, bool armed) noexcept
+    : previousSite(threadState.site), previousArmed(threadState.armed)
+{
+    auto& t = threadState;
+    t.armed = (t.depth == 0) ? armed : (t.armed && armed);
+    t.site = site;
+    ++t.depth;
+}
+
+RealtimeGuard::Scope::~Scope() noexcept
+{
+    auto& t = threadState;
+    --t.depth;
+    t.site = previousSite;
+    t.armed = previousArmed;
+}
+
+RealtimeGuard::Site::Site(const char* site) noexcept
+    : previousSite(threadState.site)
+{
+    if (threadState.depth > 0)
+        threadState.site = site;
+}
+
+RealtimeGuard::Site::~Site() noexcept
+{
+    threadState.site = previousSite;
+}
+
+void RealtimeGuard::noteLock() noexcept
+{
+   #if RTWAVESETS_REALTIME_CHECKS
+    record(Event::lock, 0);
+   #endif
+}
+
+void RealtimeGuard::setTrapping(bool shouldTrap) noexcept
+{
+    trapping.store(shouldTrap);
+}
+
+juce::Array<RealtimeGuard::SiteReport> RealtimeGuard::getReport()
+{
+    juce::Array<SiteReport> report;
+    for (auto& s : sites)
+    {
+        const char* name = s.name.load(std::memory_order_acquire);
+        if (name == nullptr)
+            break;
+        
+        SiteReport r;
+        r.site = name;
+        r.allocations = s.allocations.load();
+        r.bytes = s.bytes.load();
+        r.frees = s.frees.load();
+        r.locks = s.locks.load();
+        r.tolerated = s.tolerated.load();
+        report.add(r);
+    }
+    return report;
+}
+
+juce::uint64 RealtimeGuard::getNumViolations() noexcept
+{
+    juce::uint64 n = 0;
+    for (auto& s : sites)
+        n += s.allocations.load() + s.frees.load() + s.locks.load();
+    return n;
+}
+
+juce::String RealtimeGuard::describeReport()
+{
+    if (! isEnabled())
+        return "real-time checks are compiled out (RTWAVESETS_REALTIME_CHECKS=0)\n";
+    
+    juce::String text;
+    text << "site                                allocs       bytes       frees       locks   tolerated\n";
+    for (const auto& r : getReport())
+        text << r.site.paddedRight(' ', 30)
+             << juce::String(r.allocations).paddedLeft(' ', 12)
+             << juce::String(r.bytes).paddedLeft(' ', 12)
+             << juce::String(r.frees).paddedLeft(' ', 12)
+             << juce::String(r.locks).paddedLeft(' ', 12)
+             << juce::String(r.tolerated).paddedLeft(' ', 12) << "\n";
+    
+    if (! RTWAVESETS_REALTIME_CHECKS_LOCKS)
+        text << "(only the repo's own spin locks are tracked on this platform, not mutexes)\n";
+    return text;
+}
+
+void RealtimeGuard::reset() noexcept
+{
+    for (auto& s : sites)
+    {
+        s.allocations = 0;
+        s.bytes = 0;
+        s.frees = 0;
+        s.locks = 0;
+        s.tolerated = 0;
+    }
+}
+
+//==============================================================================
+#if RTWAVESETS_REALTIME_CHECKS
+
+void* operator new (size_t size)
+{
+    record(Event::allocation, size);
+    if (auto* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size)                                  { return operator new (size); }
+void* operator new (size_t size, const std::nothrow_t&) noexcept    { record(Event::allocation, size); return std::malloc(size == 0 ? 1 : size); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept  { return operator new (size, std::nothrow); }
+
+void operator delete (void* p) noexcept                             { if (p != nullptr) record(Event::free, 0); std::free(p); }
+void operator delete[] (void* p) noexcept                           { operator delete (p); }
+void operator delete (void* p, size_t) noexcept                     { operator delete (p); }
+void operator delete[] (void* p, size_t) noexcept                   { operator delete (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept      { operator delete (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept    { operator delete (p); }
+
+// the aligned forms (used for the SIMD centroid store) go through the same counters
+void* operator new (size_t size, std::align_val_t align)
+{
+    record(Event::allocation, size);
+    const auto a = std::max((size_t) align, sizeof (void*));
+    void* p = nullptr;
+   #if JUCE_WINDOWS
+    p = _aligned_malloc(size == 0 ? 1 : size, a);
+   #else
+    if (posix_memalign(&p, a, size == 0 ? 1 : size) != 0)
+        p = nullptr;
+   #endif
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[] (size_t size, std::align_val_t align)          { return operator new (size, align); }
+
+void operator delete (void* p, std::align_val_t) noexcept
+{
+    if (p != nullptr)
+        record(Event::free, 0);
+   #if JUCE_WINDOWS
+    _aligned_free(p);
+   #else
+    std::free(p);
+   #endif
+}
+
+void operator delete[] (void* p, std::align_val_t align) noexcept           { operator delete (p, align); }
+void operator delete (void* p, size_t, std::align_val_t align) noexcept     { operator delete (p, align); }
+void operator delete[] (void* p, size_t, std::align_val_t align) noexcept   { operator delete (p, align); }
+
+#endif
+
+#if RTWAVESETS_REALTIME_CHECKS_LOCKS && JUCE_MAC
+
+// dyld points the calls of every other image (libc++'s std::mutex, the system
+// frameworks) at the replacement. calls from inside the executable itself, JUCE's
+// CriticalSection included, are left alone, which is also why the replacement can
+// call the real function by name
+namespace
+{
+    int countingMutexLock (pthread_mutex_t* mutex) noexcept
+    {
+        record(Event::lock, 0);
+        return pthread_mutex_lock(mutex);
+    }
+    
+    struct Interpose { const void* replacement; const void* original; };
+    
+    __attribute__ ((used, section ("__DATA,__interpose")))
+    const Interpose interposeMutexLock { reinterpret_cast<const void*> (&countingMutexLock),
+                                         reinterpret_cast<const void*> (&pthread_mutex_lock) };
+}
+
+#elif RTWAVESETS_REALTIME_CHECKS_LOCKS
+
+// juce::CriticalSection and std::mutex both end up here
+extern "C" int pthread_mutex_lock (pthread_mutex_t* mutex) noexcept
+{
+    using LockFunction = int (*) (pthread_mutex_t*);
+    static std::atomic<LockFunction> real { nullptr };
+    
+    auto fn = real.load(std::memory_order_acquire);
+    if (fn == nullptr)
+    {
+        fn = reinterpret_cast<LockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        real.store(fn, std::memory_order_release);
+    }
+    
+    record(Event::lock, 0);
+    return fn(mutex);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    RealtimeGuard.h
+    Created: 16 Oct 2026 11:40:52pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// heap and lock instrumentation for the audio thread. off unless the project defines
+// RTWAVESETS_REALTIME_CHECKS=1, as the batch renderer does: it replaces the global
+// operator new/delete, which has no business inside a plugin binary a host loads
+#ifndef RTWAVESETS_REALTIME_CHECKS
+ #define RTWAVESETS_REALTIME_CHECKS 0
+#endif
+
+// a thread that opens a real-time scope has its allocations, frees and mutex locks
+// counted against the innermost site label, until the scope closes. an armed scope
+// counts them as violations (and aborts in trapping mode); an unarmed one, e.g. during
+// warm-up or an offline render, only tallies them as tolerated.
+//
+// allocations are caught by replacing the global operator new/delete. mutex locks are
+// caught by wrapping pthread_mutex_lock, which only takes effect in executables
+// (standalone, the tools): on Linux by replacing the symbol, which sees every caller;
+// on macOS by dyld interposing, which sees std::mutex and the system frameworks but
+// not JUCE's CriticalSection, compiled into the executable itself. juce::SpinLock
+// never reaches pthreads, so the repo's spin locks announce themselves with
+// RTWAVESETS_REALTIME_LOCK right before locking.
+// everything here compiles to nothing when the checks are off
+namespace RealtimeGuard
+{
+    // opens a scope on the calling thread; nested scopes can only narrow arming
+    class Scope
+    {
+    public:
+        Scope(const char* site, bool armed) noexcept;
+        ~Scope() noexcept;
+    
+    private:
+        const char* previousSite;
+        bool previousArmed;
+        
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+    
+    // relabels whatever happens inside it, if the thread is in a scope at all
+    class Site
+    {
+    public:
+        explicit Site(const char* site) noexcept;
+        ~Site() noexcept;
+    
+    private:
+        const char* previousSite;
+        
+        JUCE_DECLARE_NON_COPYABLE (Site)
+    };
+    
+    struct SiteReport
+    {
+        juce::String site;
+        juce::uint64 allocations = 0, bytes = 0, frees = 0, locks = 0;
+        juce::uint64 tolerated = 0; // any of the above while unarmed
+    };
+    
+    constexpr bool isEnabled() noexcept { return RTWAVESETS_REALTIME_CHECKS != 0; }
+    
+    // counts a lock the wrappers can't see, e.g. a juce::SpinLock
+    void noteLock() noexcept;
+    
+    // abort with a message at the first violation instead of counting it
+    void setTrapping(bool shouldTrap) noexcept;
+    
+    // not real-time safe: call from anywhere but the audio thread
+    juce::Array<SiteReport> getReport();
+    juce::uint64 getNumViolations() noexcept;
+    juce::String describeReport();
+    void reset() noexcept;
+}
+
+#if RTWAVESETS_REALTIME_CHECKS
+ #define RTWAVESETS_REALTIME_SCOPE(site, armed) RealtimeGuard::Scope JUCE_JOIN_MACRO (realtimeScope_, __LINE__) (site, armed)
+ #define RTWAVESETS_REALTIME_SITE(site)         RealtimeGuard::Site JUCE_JOIN_MACRO (realtimeSite_, __LINE__) (site)
+ #define RTWAVESETS_REALTIME_LOCK()             RealtimeGuard::noteLock()
+#else
+ #define RTWAVESETS_REALTIME_SCOPE(site, armed)
+ #define RTWAVESETS_REALTIME_SITE(site)
+ #define RTWAVESETS_REALTIME_LOCK()
+#endif
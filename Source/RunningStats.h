@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    RunningStats.h
+    Created: 16 Oct 2026 5:12:08pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// mean/variance over a sliding window with O(1) add and remove: Welford's update,
+// run backwards for removals. removals pile up a little rounding error over time,
+// so the owner should clear() and re-add the window every so often
+class RunningStats
+{
+public:
+    void clear() noexcept
+    {
+        count = 0;
+        mean = 0.0;
+        m2 = 0.0;
+    }
+    
+    void add(double x) noexcept
+    {
+        ++count;
+        const double d = x - mean;
+        mean += d / count;
+        m2 += d * (x - mean);
+    }
+    
+    void remove(double x) noexcept
+    {
+        if (count <= 1)
+        {
+            clear();
+            return;
+        }
+        
+        --count;
+        const double d = x - mean;
+        mean -= d / count;
+        m2 -= d * (x - mean);
+    }
+    
+    int getCount() const noexcept { return count; }
+    double getMean() const noexcept { return mean; }
+    
+    // population variance, like the batch stats it replaces
+    double getVariance() const noexcept { return count > 0 ? std::max(0.0, m2 / count) : 0.0; }
+    
+private:
+    int count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+};
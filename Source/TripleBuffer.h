@@ -0,0 +1,66 @@
+/*
+  ==============================================================================
+
+    TripleBuffer.h
+    Created: 16 Oct 2026 2:20:11pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+// single-producer / single-consumer "latest value wins" exchange. both sides are
+// wait-free and never allocate: the producer fills its private buffer in place and
+// publishes it, the consumer picks up the most recent one whenever it likes.
+// storage is three T's, all default-constructed up front
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    
+    // producer: fill this in place, then publish()
+    T& getWriteBuffer() noexcept { return buffers[(size_t) writeIndex]; }
+    
+    void publish() noexcept
+    {
+        const int previous = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel);
+        writeIndex = previous & indexMask;
+    }
+    
+    // consumer: swaps in the newest published buffer, false if nothing new arrived
+    bool acquire() noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+            return false;
+        
+        const int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & indexMask;
+        return true;
+    }
+    
+    // consumer: stays stable until the consumer's next acquire()
+    const T& getReadBuffer() const noexcept { return buffers[(size_t) readIndex]; }
+    
+    // not thread-safe: for sizing storage before either side starts using it
+    template <typename Fn>
+    void forEachBuffer(Fn&& fn)
+    {
+        for (auto& b : buffers)
+            fn(b);
+    }
+    
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshBit = 4;
+    
+    std::array<T, 3> buffers {};
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle { 2 };
+};
@@ -0,0 +1,39 @@
+/*
+  ==============================================================================
+
+    VisualizationSnapshot.h
+    Created: 16 Oct 2026 2:20:11pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "WavesetFeatures.h"
+#include <array>
+
+// fixed-size copy of what the cluster view draws, published by the audio thread
+// through a TripleBuffer so the editor never touches live engine state
+struct VisualizationSnapshot
+{
+    static constexpr int maxCentroids = 4096;
+    static constexpr int maxPoints = 1024;
+    
+    std::array<std::array<float,2>, maxCentroids> centroids {};
+    int numCentroids = 0;
+    
+    // rtefc: recent points, k-means: the current window
+    std::array<std::array<float,2>, maxPoints> points {};
+    std::array<int, maxPoints> assignments {}; // cluster per point, -1 if the engine doesn't assign
+    int numPoints = 0;
+    
+    std::array<float,2> currentPoint {};
+    bool hasCurrentPoint = false;
+    
+    float distanceEma = 0.0f;
+    
+    // the view plots length against rms, the first two feature axes
+    static std::array<float,2> project(const FeatureVector& x) noexcept { return { x[0], x[1] }; }
+};
@@ -0,0 +1,155 @@
+/*
+  ==============================================================================
+
+    WavesetFeatures.cpp
+    Created: 16 Oct 2026 8:21:06pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "WavesetFeatures.h"
+
+namespace
+{
+    struct Accumulators
+    {
+        float sum = 0.0f, sumSq = 0.0f, sumSqRight = 0.0f, peak = 0.0f;
+        float harmonicRe = 0.0f, harmonicIm = 0.0f;
+        float prevDiff = 0.0f;
+        int zeroSlopes = 0;
+    };
+    
+    // slope sign changes; flat runs keep the last non-zero slope
+    inline void countSlope(const float* left, int i, Accumulators& acc) noexcept
+    {
+        if (i <= 0)
+            return;
+        
+        const float diff = left[i] - left[i - 1];
+        if (diff * acc.prevDiff < 0.0f)
+            ++acc.zeroSlopes;
+        if (diff != 0.0f)
+            acc.prevDiff = diff;
+    }
+    
+    void analyseScalar(const float* left, const float* right, int start, int end, double omega, Accumulators& acc) noexcept
+    {
+        for (int i = start; i < end; ++i)
+        {
+            const float x = left[i];
+            acc.sum += x;
+            acc.sumSq += x * x;
+            acc.sumSqRight += right[i] * right[i];
+            acc.peak = std::max(acc.peak, std::abs(x));
+            acc.harmonicRe += x * (float) std::cos(omega * i);
+            acc.harmonicIm += x * (float) std::sin(omega * i);
+            countSlope(left, i, acc);
+        }
+    }
+}
+
+WavesetDescriptors WavesetAnalyser::analyse(const juce::AudioBuffer<float>& waveset) noexcept
+{
+    WavesetDescriptors d;
+    
+    const int n = waveset.getNumSamples();
+    d[WavesetDescriptor::length] = (float) n;
+    d[WavesetDescriptor::crestFactor] = 1.0f;
+    if (n <= 0 || waveset.getNumChannels() <= 0)
+        return d;
+    
+    const float* left = waveset.getReadPointer(0);
+    const float* right = waveset.getReadPointer(std::min(1, waveset.getNumChannels() - 1));
+    
+    // a waveset is one period, so the fundamental is DFT bin 1 over its length
+    const double omega = juce::MathConstants<double>::twoPi / n;
+    
+    Accumulators acc;
+    int i = 0;
+    
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    constexpr int width = (int) Vec::SIMDNumElements;
+    
+    // scalar lead-in up to the first aligned left sample
+    const auto* aligned = Vec::getNextSIMDAlignedPtr(const_cast<float*>(left));
+    const int leadIn = std::min(n, (int) (aligned - left));
+    analyseScalar(left, right, 0, leadIn, omega, acc);
+    i = leadIn;
+    
+    if (i + width <= n)
+    {
+        Vec sum = Vec::expand(0.0f), sumSq = sum, sumSqRight = sum, peak = sum, re = sum, im = sum;
+        
+        // one phasor per lane, all rotated by width samples each step
+        Vec phasorRe, phasorIm;
+        for (int lane = 0; lane < width; ++lane)
+        {
+            phasorRe.set((size_t) lane, (float) std::cos(omega * (i + lane)));
+            phasorIm.set((size_t) lane, (float) std::sin(omega * (i + lane)));
+        }
+        const Vec stepRe = Vec::expand((float) std::cos(omega * width));
+        const Vec stepIm = Vec::expand((float) std::sin(omega * width));
+        
+        // channels of one buffer share alignment, but views into odd layouts may not
+        const bool rightAligned = (Vec::getNextSIMDAlignedPtr(const_cast<float*>(right + i)) == right + i);
+        alignas(sizeof(Vec)) float rightScratch[width];
+        
+        for (; i + width <= n; i += width)
+        {
+            const Vec x = Vec::fromRawArray(left + i);
+            Vec r;
+            if (rightAligned)
+            {
+                r = Vec::fromRawArray(right + i);
+            }
+            else
+            {
+                std::copy_n(right + i, width, rightScratch);
+                r = Vec::fromRawArray(rightScratch);
+            }
+            
+            sum += x;
+            sumSq += x * x;
+            sumSqRight += r * r;
+            peak = Vec::max(peak, Vec::abs(x));
+            re += x * phasorRe;
+            im += x * phasorIm;
+            
+            const Vec nextRe = phasorRe * stepRe - phasorIm * stepIm;
+            phasorIm = phasorRe * stepIm + phasorIm * stepRe;
+            phasorRe = nextRe;
+            
+            for (int j = i; j < i + width; ++j)
+                countSlope(left, j, acc);
+        }
+        
+        acc.sum += sum.sum();
+        acc.sumSq += sumSq.sum();
+        acc.sumSqRight += sumSqRight.sum();
+        acc.harmonicRe += re.sum();
+        acc.harmonicIm += im.sum();
+        for (int lane = 0; lane < width; ++lane)
+            acc.peak = std::max(acc.peak, peak.get((size_t) lane));
+    }
+   #endif
+    
+    analyseScalar(left, right, i, n, omega, acc);
+    
+    const float rms = std::sqrt(acc.sumSq / (float) n);
+    d[WavesetDescriptor::rms] = rms;
+    d[WavesetDescriptor::rmsRight] = std::sqrt(acc.sumSqRight / (float) n);
+    d[WavesetDescriptor::peak] = acc.peak;
+    d[WavesetDescriptor::crestFactor] = rms > 1.0e-9f ? acc.peak / rms : 1.0f;
+    d[WavesetDescriptor::dcOffset] = acc.sum / (float) n;
+    d[WavesetDescriptor::zeroSlopes] = (float) acc.zeroSlopes;
+    
+    // a pure sine of amplitude A has |X1|^2 = (nA/2)^2 and energy nA^2/2, giving 1
+    const float harmonicEnergy = acc.harmonicRe * acc.harmonicRe + acc.harmonicIm * acc.harmonicIm;
+    d[WavesetDescriptor::firstHarmonic] = acc.sumSq > 1.0e-12f
+        ? juce::jlimit(0.0f, 1.0f, 2.0f * harmonicEnergy / ((float) n * acc.sumSq))
+        : 0.0f;
+    
+    return d;
+}
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    WavesetFeatures.h
+    Created: 16 Oct 2026 8:21:06pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+// everything the analysis pass knows how to measure about one waveset
+enum class WavesetDescriptor
+{
+    length,        // samples
+    rms,           // left channel
+    rmsRight,      // right channel (left again for mono input)
+    peak,          // left channel absolute peak
+    crestFactor,   // peak / rms
+    dcOffset,      // left channel mean
+    zeroSlopes,    // local extrema, i.e. sign changes of the slope
+    firstHarmonic, // share of the energy in the fundamental (1 for a pure sine)
+    numDescriptors
+};
+
+// level-like descriptors are compared on a log scale by the online normalizer
+constexpr bool isLevelDescriptor(WavesetDescriptor d) noexcept
+{
+    return d == WavesetDescriptor::rms || d == WavesetDescriptor::rmsRight || d == WavesetDescriptor::peak;
+}
+
+struct WavesetDescriptors
+{
+    std::array<float, (size_t) WavesetDescriptor::numDescriptors> values {};
+    
+    float  operator[] (WavesetDescriptor d) const noexcept { return values[(size_t) d]; }
+    float& operator[] (WavesetDescriptor d) noexcept       { return values[(size_t) d]; }
+};
+
+// computes every descriptor in one pass over the waveset: the reductions (energy,
+// peak, mean, harmonic correlation) run a SIMD register at a time, the slope count
+// walks the same samples while they're in cache
+struct WavesetAnalyser
+{
+    static WavesetDescriptors analyse(const juce::AudioBuffer<float>& waveset) noexcept;
+};
+
+// picks the descriptors the engines cluster on. the dimension is a compile-time
+// constant so centroid stores and distance loops unroll completely
+template <WavesetDescriptor... Descriptors>
+struct FeatureSet
+{
+    static constexpr int dimension = (int) sizeof...(Descriptors);
+    using Vector = std::array<float, (size_t) dimension>;
+    
+    static constexpr std::array<WavesetDescriptor, (size_t) dimension> descriptors { Descriptors... };
+    
+    static Vector select(const WavesetDescriptors& d) noexcept { return { d[Descriptors]... }; }
+};
+
+// the features both engines use. length and rms have to stay first: the length
+// weight applies to axis 0, and the spatial index and the visualization use the
+// first two axes
+using WavesetFeatures = FeatureSet<WavesetDescriptor::length,
+                                   WavesetDescriptor::rms,
+                                   WavesetDescriptor::crestFactor,
+                                   WavesetDescriptor::firstHarmonic>;
+
+constexpr int featureDimension = WavesetFeatures::dimension;
+using FeatureVector = WavesetFeatures::Vector;
+
+static_assert(featureDimension >= 2
+              && WavesetFeatures::descriptors[0] == WavesetDescriptor::length
+              && WavesetFeatures::descriptors[1] == WavesetDescriptor::rms,
+              "length and rms must be the first two features");
@@ -0,0 +1,38 @@
+/*
+  ==============================================================================
+
+    WavesetHandle.h
+    Created: 16 Oct 2026 1:05:48pm
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// non-owning view of a representative waveset that lives in an engine's own storage.
+//
+// lifetime: a handle returned by processWaveset() stays readable until the next
+// processWaveset() call on the same engine, or until that engine's storage
+// generation moves on (reset, prepare, the storage growing or its audio being
+// overwritten), whichever comes first. compare generation against the engine's getStorageGeneration()
+// before reading from it
+struct WavesetHandle
+{
+    static constexpr int maxChannels = 2;
+    
+    const float* channels[maxChannels] { nullptr, nullptr };
+    int numChannels = 0;
+    int numSamples = 0;
+    juce::uint32 generation = 0;
+    
+    bool isEmpty() const noexcept { return numSamples <= 0 || numChannels <= 0; }
+    
+    // channels past numChannels repeat the last one (mono storage into a stereo output)
+    const float* getReadPointer(int channel, int sampleIndex = 0) const noexcept
+    {
+        return channels[std::min(channel, numChannels - 1)] + sampleIndex;
+    }
+};
@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    WavesetQueue.h
+    Created: 17 Oct 2026 6:20:44am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+// wait-free single-producer / single-consumer queue of whole wavesets, from the audio
+// thread (which segments) to the analysis side (which runs the engines). samples go
+// into one circular buffer and lengths into a second fifo; both are sized in prepare(),
+// so neither side allocates. a waveset that doesn't fit is dropped, not waited for
+class WavesetQueue
+{
+public:
+    WavesetQueue() = default;
+    
+    // while neither side is running
+    void prepare(int numChannels, int sampleCapacity, int maxWavesets)
+    {
+        samples.setSize(numChannels, sampleCapacity + 1);
+        sampleFifo.setTotalSize(sampleCapacity + 1);
+        lengths.assign((size_t) maxWavesets + 1, 0);
+        lengthFifo.setTotalSize(maxWavesets + 1);
+        reset();
+    }
+    
+    void reset() noexcept
+    {
+        sampleFifo.reset();
+        lengthFifo.reset();
+    }
+    
+    // producer: false if there was no room and the waveset was dropped
+    bool push(const juce::AudioBuffer<float>& waveset) noexcept
+    {
+        const int length = waveset.getNumSamples();
+        if (length <= 0 || waveset.getNumChannels() <= 0
+            || sampleFifo.getFreeSpace() < length || lengthFifo.getFreeSpace() < 1)
+            return false;
+        
+        // samples first: the consumer only looks for them once it has seen the length
+        {
+            const auto scope = sampleFifo.write(length);
+            for (int ch = 0; ch < samples.getNumChannels(); ++ch)
+            {
+                const int src = std::min(ch, waveset.getNumChannels() - 1);
+                if (scope.blockSize1 > 0)
+                    samples.copyFrom(ch, scope.startIndex1, waveset, src, 0, scope.blockSize1);
+                if (scope.blockSize2 > 0)
+                    samples.copyFrom(ch, scope.startIndex2, waveset, src, scope.blockSize1, scope.blockSize2);
+            }
+        }
+        
+        const auto scope = lengthFifo.write(1);
+        lengths[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = length;
+        return true;
+    }
+    
+    // consumer: moves the oldest waveset into dest, which must already have room for
+    // the longest one (it is only resized within its allocation). false if empty
+    bool pop(juce::AudioBuffer<float>& dest) noexcept
+    {
+        if (lengthFifo.getNumReady() < 1)
+            return false;
+        
+        int length = 0;
+        {
+            const auto scope = lengthFifo.read(1);
+            length = lengths[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+        }
+        
+        dest.setSize(samples.getNumChannels(), length, false, false, true);
+        const auto scope = sampleFifo.read(length);
+        for (int ch = 0; ch < samples.getNumChannels(); ++ch)
+        {
+            if (scope.blockSize1 > 0)
+                dest.copyFrom(ch, 0, samples, ch, scope.startIndex1, scope.blockSize1);
+            if (scope.blockSize2 > 0)
+                dest.copyFrom(ch, scope.blockSize1, samples, ch, scope.startIndex2, scope.blockSize2);
+        }
+        return true;
+    }
+    
+    // either side; a snapshot
+    int getNumReady() const noexcept { return lengthFifo.getNumReady(); }
+
+private:
+    juce::AudioBuffer<float> samples;
+    juce::AbstractFifo sampleFifo { 1 };
+    std::vector<int> lengths;
+    juce::AbstractFifo lengthFifo { 1 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WavesetQueue)
+};
@@ -0,0 +1,46 @@
+/*
+  ==============================================================================
+
+    WavesetSegmenter.cpp
+    Created: 16 Oct 2026 10:12:03am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "WavesetSegmenter.h"
+
+void WavesetSegmenter::prepare(int numChannels, int maxWavesetLength, int maxBlockSize)
+{
+    assembly.setSize(numChannels, maxWavesetLength);
+    assembly.clear();
+    crossingPositions.assign((size_t) std::max(1, maxBlockSize), 0);
+    reset();
+}
+
+void WavesetSegmenter::release()
+{
+    assembly.setSize(0, 0);
+    crossingPositions.clear();
+    crossingPositions.shrink_to_fit();
+    reset();
+}
+
+void WavesetSegmenter::reset()
+{
+    assemblyLength = 0;
+    scanner.reset();
+}
+
+void WavesetSegmenter::append(const float* const* input, int numInputChannels, int start, int numSamples)
+{
+    const int toCopy = std::min(numSamples, assembly.getNumSamples() - assemblyLength);
+    if (toCopy <= 0)
+        return;
+    
+    // channels beyond the input (e.g. mono into stereo) duplicate the last input channel
+    for (int ch = 0; ch < assembly.getNumChannels(); ++ch)
+        assembly.copyFrom(ch, assemblyLength, input[std::min(ch, numInputChannels - 1)] + start, toCopy);
+    
+    assemblyLength += toCopy;
+}
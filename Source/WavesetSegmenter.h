@@ -0,0 +1,80 @@
+/*
+  ==============================================================================
+
+    WavesetSegmenter.h
+    Created: 16 Oct 2026 10:12:03am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ZeroCrossingScanner.h"
+
+// splits incoming audio into wavesets one block at a time. a waveset ends on (and
+// includes) the first sample of every positive-going zero crossing on channel 0
+class WavesetSegmenter
+{
+public:
+    WavesetSegmenter() = default;
+    
+    void prepare(int numChannels, int maxWavesetLength, int maxBlockSize);
+    void release();
+    void reset();
+    
+    void setHysteresis(float newHysteresis) noexcept { scanner.setHysteresis(newHysteresis); }
+    void setMinimumLength(int newMinimumLength) noexcept { scanner.setMinimumLength(newMinimumLength); }
+    
+    // scans numSamples of input, calling onWaveset(crossingIndex, waveset) for every
+    // completed waveset. crossingIndex is the block position of the sample that closed
+    // it, and waveset is only valid for the duration of the callback
+    template <typename Callback>
+    void process(const float* const* input, int numInputChannels, int numSamples, Callback&& onWaveset)
+    {
+        if (numInputChannels <= 0 || assembly.getNumChannels() <= 0 || crossingPositions.empty())
+            return;
+        
+        // crossings for a whole chunk are found up front, then each segment is copied in one go
+        const int chunkSize = (int) crossingPositions.size();
+        for (int chunkStart = 0; chunkStart < numSamples; chunkStart += chunkSize)
+        {
+            const int chunkEnd = std::min(numSamples, chunkStart + chunkSize);
+            const int numCrossings = scanner.scan(input[0] + chunkStart, chunkEnd - chunkStart, crossingPositions.data());
+            
+            int segmentStart = chunkStart;
+            for (int c = 0; c < numCrossings; ++c)
+            {
+                const int crossing = chunkStart + crossingPositions[(size_t) c];
+                append(input, numInputChannels, segmentStart, crossing + 1 - segmentStart);
+                
+                if (assemblyLength > 1)
+                {
+                    // exact-length view onto the assembly buffer, no copy or realloc
+                    wavesetView.setDataToReferTo(assembly.getArrayOfWritePointers(), assembly.getNumChannels(), 0, assemblyLength);
+                    onWaveset(crossing, static_cast<const juce::AudioBuffer<float>&>(wavesetView));
+                }
+                
+                // only [0, assemblyLength) is ever read, so rewinding is enough
+                assemblyLength = 0;
+                segmentStart = crossing + 1;
+            }
+            
+            append(input, numInputChannels, segmentStart, chunkEnd - segmentStart);
+        }
+    }
+    
+private:
+    // copies as much of the span as still fits into the assembly buffer
+    void append(const float* const* input, int numInputChannels, int start, int numSamples);
+    
+    juce::AudioBuffer<float> assembly;
+    juce::AudioBuffer<float> wavesetView;
+    int assemblyLength = 0;
+    
+    ZeroCrossingScanner scanner;
+    std::vector<int> crossingPositions; // one slot per sample of the largest chunk scanned at once
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WavesetSegmenter)
+};
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    WorkerPool.cpp
+    Created: 17 Oct 2026 8:03:51am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool()
+{
+    // one core stays free for the host's audio thread
+    const int numWorkers = juce::jmax(1, juce::SystemStats::getNumCpus() - 1);
+    for (int i = 0; i < numWorkers; ++i)
+        workers.add(new Worker(*this, i));
+    
+    for (auto* w : workers)
+        w->startThread(juce::Thread::Priority::high);
+}
+
+WorkerPool::~WorkerPool()
+{
+    // every holder removes its clients before letting go of the pool
+    for (auto* w : workers)
+        jassert(w->getNumClients() == 0);
+    
+    for (auto* w : workers)
+        w->signalThreadShouldExit();
+    notify();
+    for (auto* w : workers)
+        w->stopThread(1000);
+}
+
+void WorkerPool::add(Client& client, Priority priority)
+{
+    const juce::ScopedWriteLock sl (clientsLock);
+    if (client.worker >= 0)
+        return;
+    
+    // new clients go to whichever worker has the fewest, so one instance's jobs end up
+    // on different workers
+    int target = 0;
+    for (int i = 1; i < workers.size(); ++i)
+        if (workers[i]->getNumClients() < workers[target]->getNumClients())
+            target = i;
+    
+    client.priority = priority;
+    client.worker = target;
+    workers[target]->clients[(size_t) priority].push_back(&client);
+    ++numClients;
+    
+    // nobody polls an empty pool, and the new client's worker should look at it now
+    notify();
+}
+
+void WorkerPool::remove(Client& client)
+{
+    // taking the write lock waits out every pass in progress, including any slice of
+    // this client's
+    const juce::ScopedWriteLock sl (clientsLock);
+    if (client.worker < 0)
+        return;
+    
+    auto& list = workers[client.worker]->clients[(size_t) client.priority];
+    list.erase(std::remove(list.begin(), list.end(), &client), list.end());
+    client.worker = -1;
+    --numClients;
+    
+    // workers left without clients of their own go over to the longer steal backoff
+    notify();
+}
+
+void WorkerPool::notify()
+{
+    for (auto* w : workers)
+        w->notify();
+}
+
+bool WorkerPool::runPass(Worker& worker)
+{
+    const juce::ScopedReadLock sl (clientsLock);
+    
+    for (size_t p = 0; p < (size_t) numPriorities; ++p)
+    {
+        if (serviceOwnClients(worker, p))
+            return true;
+        
+        for (int i = 1; i < workers.size(); ++i)
+            if (stealFrom(worker, *workers[(worker.index + i) % workers.size()], p))
+                return true;
+    }
+    
+    return false;
+}
+
+int WorkerPool::getIdleWaitMs(Worker& worker)
+{
+    const juce::ScopedReadLock sl (clientsLock);
+    
+    if (numClients == 0)
+        return -1;
+    
+    // with the transport stopped nobody has work, and a pool of idle workers shouldn't
+    // keep waking every core. a worker's own clients still get looked at within a few
+    // ms once work turns up again; one that can only steal has no deadline to keep
+    const int maxWaitMs = worker.getNumClients() > 0 ? maxOwnWaitMs : maxStealWaitMs;
+    const int wait = std::min(worker.waitMs, maxWaitMs);
+    worker.waitMs = std::min(maxWaitMs, wait * 2);
+    return wait;
+}
+
+bool WorkerPool::serviceOwnClients(Worker& worker, size_t priority)
+{
+    const auto& list = worker.clients[priority];
+    const size_t n = list.size();
+    if (n == 0)
+        return false;
+    
+    bool didWork = false;
+    const size_t start = worker.nextClient[priority] % n;
+    worker.nextClient[priority] = start + 1;
+    for (size_t i = 0; i < n; ++i)
+        didWork |= tryService(*list[(start + i) % n]);
+    return didWork;
+}
+
+bool WorkerPool::stealFrom(Worker& thief, const Worker& victim, size_t priority)
+{
+    // one slice at a time, then back to our own clients
+    const auto& list = victim.clients[priority];
+    const size_t start = thief.nextSteal++;
+    for (size_t i = 0; i < list.size(); ++i)
+        if (tryService(*list[(start + i) % list.size()]))
+            return true;
+    
+    return false;
+}
+
+bool WorkerPool::tryService(Client& client)
+{
+    if (client.busy.exchange(true, std::memory_order_acquire))
+        return false;
+    
+    const bool didWork = client.service();
+    client.busy.store(false, std::memory_order_release);
+    return didWork;
+}
+
+//==============================================================================
+WorkerPool::Worker::Worker(WorkerPool& p, int i)
+    : juce::Thread("Worker pool " + juce::String(i)), pool(p), index(i)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    while (! threadShouldExit())
+    {
+        if (pool.runPass(*this))
+            waitMs = minWaitMs;
+        else
+            wait(pool.getIdleWaitMs(*this));
+    }
+}
+
+int WorkerPool::Worker::getNumClients() const noexcept
+{
+    int n = 0;
+    for (const auto& list : clients)
+        n += (int) list.size();
+    return n;
+}
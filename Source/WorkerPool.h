@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+    Created: 17 Oct 2026 8:03:51am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+// background threads shared by every plugin instance in the process, so a session with
+// dozens of instances doesn't run dozens of analysis and refresh threads of its own.
+// hold it through juce::SharedResourcePointer<WorkerPool>: the first holder starts the
+// workers and the last one to go stops them.
+//
+// work comes from clients, each a recurring job such as one instance's analysis or one
+// engine's refreshes. every client lives on one worker, and a client is never serviced
+// by two workers at once. priorities are strict: a pass offers a slice to each of the
+// worker's own clients of the highest priority, then steals one from another worker's,
+// and only goes down a priority if nobody at this one had anything to do. so when the
+// pool is oversubscribed, refreshes wait for the analysis playback depends on rather
+// than sharing the cores with it. within a priority it is fair: every client gets one
+// bounded slice per turn, in rotating order, so instances get equal shares however
+// many of them there are.
+//
+// a worker with nothing to do polls again after minWaitMs, backing off with every idle
+// pass up to maxOwnWaitMs if it has clients of its own, or maxStealWaitMs if it could
+// only steal. it sleeps until add() or remove() wakes it while the pool has no clients
+class WorkerPool
+{
+public:
+    enum class Priority { high, normal };
+    
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+        
+        // does a bounded amount of work, if there is any; returns false if there was none
+        virtual bool service() = 0;
+    
+    private:
+        friend class WorkerPool;
+        std::atomic<bool> busy { false };
+        Priority priority = Priority::normal;
+        int worker = -1; // the worker it lives on, -1 while not added
+    };
+    
+    WorkerPool();
+    ~WorkerPool();
+    
+    // not from a worker. adding a client that is already added does nothing; once remove()
+    // returns, the client isn't being serviced and won't be again until it is added back
+    void add(Client& client, Priority priority);
+    void remove(Client& client);
+    
+    // wakes idle workers now rather than at the end of their wait, when a client has just
+    // been given something urgent
+    void notify();
+    
+    int getNumWorkers() const noexcept { return workers.size(); }
+
+private:
+    static constexpr int numPriorities = 2;
+    static constexpr int minWaitMs = 1;
+    static constexpr int maxOwnWaitMs = 4;
+    static constexpr int maxStealWaitMs = 16;
+    
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(WorkerPool& p, int index);
+        void run() override;
+        
+        // one list per priority, in the order slices are offered; the next pass starts one
+        // further along each, so no client is always first. changed under the write lock
+        std::array<std::vector<Client*>, numPriorities> clients;
+        std::array<size_t, numPriorities> nextClient {};
+        size_t nextSteal = 0; // the same for the clients it steals
+        int waitMs = minWaitMs; // doubles with every idle pass, back to minWaitMs after work
+        
+        int getNumClients() const noexcept;
+        
+        WorkerPool& pool;
+        const int index;
+    };
+    
+    juce::OwnedArray<Worker> workers;
+    
+    // workers read the client lists for a whole pass, add() and remove() write them. a
+    // waiting writer holds off new passes, so it only ever waits for the current ones
+    juce::ReadWriteLock clientsLock;
+    
+    int numClients = 0; // in the whole pool, changed under the write lock
+    
+    bool runPass(Worker& worker);
+    int getIdleWaitMs(Worker& worker); // after a pass with nothing to do; -1 to sleep until notified
+    bool serviceOwnClients(Worker& worker, size_t priority);
+    bool stealFrom(Worker& thief, const Worker& victim, size_t priority);
+    static bool tryService(Client& client);
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WorkerPool)
+};
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    ZeroCrossingScanner.cpp
+    Created: 16 Oct 2026 11:40:27am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#include "ZeroCrossingScanner.h"
+
+void ZeroCrossingScanner::reset() noexcept
+{
+    armed = true;
+    samplesSinceCrossing = 0;
+}
+
+int ZeroCrossingScanner::scanScalar(const float* samples, int start, int end, int* positions, int found) noexcept
+{
+    for (int i = start; i < end; ++i)
+    {
+        const float x = samples[i];
+        samplesSinceCrossing = std::min(samplesSinceCrossing + 1, minimumLength);
+        
+        if (x > hysteresis)
+        {
+            if (armed && samplesSinceCrossing >= minimumLength)
+            {
+                positions[found++] = i;
+                samplesSinceCrossing = 0;
+            }
+            armed = false;
+        }
+        else if (x <= -hysteresis)
+        {
+            armed = true;
+        }
+    }
+    
+    return found;
+}
+
+int ZeroCrossingScanner::scan(const float* samples, int numSamples, int* positions) noexcept
+{
+    int found = 0;
+    int i = 0;
+    
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<float>;
+    constexpr int width = (int) Vec::SIMDNumElements;
+    
+    // scalar lead-in up to the first aligned sample
+    const auto* aligned = Vec::getNextSIMDAlignedPtr(const_cast<float*>(samples));
+    const int leadIn = std::min(numSamples, (int) (aligned - samples));
+    found = scanScalar(samples, 0, leadIn, positions, found);
+    i = leadIn;
+    
+    const Vec high = Vec::expand(hysteresis);
+    const Vec low = Vec::expand(-hysteresis);
+    
+    // most chunks sit entirely on one side of zero: if armed, nothing happens until a lane
+    // rises above +hysteresis; if not armed, nothing happens until a lane dips to -hysteresis.
+    // only chunks that could change state fall back to the scalar state machine
+    for (; i + width <= numSamples; i += width)
+    {
+        const Vec x = Vec::fromRawArray(samples + i);
+        const bool canChange = armed ? Vec::greaterThan(x, high).sum() != 0
+                                     : Vec::lessThanOrEqual(x, low).sum() != 0;
+        
+        if (canChange)
+            found = scanScalar(samples, i, i + width, positions, found);
+        else
+            samplesSinceCrossing = std::min(samplesSinceCrossing + width, minimumLength);
+    }
+   #endif
+    
+    return scanScalar(samples, i, numSamples, positions, found);
+}
@@ -0,0 +1,44 @@
+/*
+  ==============================================================================
+
+    ZeroCrossingScanner.h
+    Created: 16 Oct 2026 11:40:27am
+    Author:  Nicholas Boyko
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// finds positive-going zero crossings over a whole block in one pass. with the
+// defaults (no hysteresis, no minimum length) a crossing is any sample > 0 whose
+// predecessor was <= 0, exactly like the old per-sample sign check
+class ZeroCrossingScanner
+{
+public:
+    ZeroCrossingScanner() = default;
+    
+    // the signal has to dip to <= -hysteresis before a rise above +hysteresis counts
+    void setHysteresis(float newHysteresis) noexcept { hysteresis = std::max(0.0f, newHysteresis); }
+    
+    // crossings closer than this many samples to the previous one are ignored
+    void setMinimumLength(int newMinimumLength) noexcept { minimumLength = std::max(0, newMinimumLength); }
+    
+    void reset() noexcept;
+    
+    // writes the index of every crossing in samples[0, numSamples) to positions, which
+    // must have room for numSamples entries. returns the number of crossings found
+    int scan(const float* samples, int numSamples, int* positions) noexcept;
+    
+private:
+    // scalar state machine for [start, end), shared by the vector path's slow lanes
+    int scanScalar(const float* samples, int start, int end, int* positions, int found) noexcept;
+    
+    float hysteresis = 0.0f;
+    int minimumLength = 0;
+    
+    bool armed = true;           // signal has been at or below -hysteresis since the last crossing
+    int samplesSinceCrossing = 0; // saturates at minimumLength
+};
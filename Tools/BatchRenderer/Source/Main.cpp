@@ -0,0 +1,362 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 16 Oct 2026 10:05:17pm
+    Author:  Nicholas Boyko
+
+    renders audio files through the plugin without a host: every file gets a
+    fresh run of the processor in non-realtime mode, and independent files are
+    spread over a pool of workers, one processor each. --rt-check renders in
+    realtime mode instead and fails if the audio path allocates or locks
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/RealtimeGuard.h"
+
+namespace
+{
+    struct Settings
+    {
+        juce::Array<juce::File> inputs;
+        juce::File outputFolder;
+        juce::String suffix { "_wavesets" };
+        int numWorkers = juce::SystemStats::getNumCpus();
+        int blockSize = 512;
+        juce::StringPairArray parameters; // id -> value in the parameter's own units
+        bool checkRealtime = false;
+        bool trapRealtime = false;
+    };
+    
+    void printUsage()
+    {
+        std::cout << "usage: RTWavesetsBatch [options] <files or folders...>\n\n"
+                  << "  --out <folder>      where rendered files go (default: next to each input)\n"
+                  << "  --suffix <text>     appended to each output name (default: _wavesets)\n"
+                  << "  --jobs <n>          files rendered in parallel (default: number of cores)\n"
+                  << "  --block <n>         processing block size in samples (default: 512)\n"
+                  << "  --mode <engine>     rtefc or kmeans\n"
+                  << "  --set <id>=<value>  any plugin parameter, in its own units (repeatable)\n"
+                  << "  --list-params       print the parameter ids and ranges, then exit\n"
+                  << "  --rt-check          render in realtime mode and report heap use and locks on the\n"
+                  << "                      audio path; exits with 1 if there were any (checked builds)\n"
+                  << "  --rt-trap           like --rt-check, but abort at the first one\n";
+    }
+    
+    void listParameters()
+    {
+        RTWavesetsAudioProcessor processor;
+        for (auto* p : processor.getParameters())
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(p))
+            {
+                const auto& range = ranged->getNormalisableRange();
+                std::cout << ranged->getParameterID().paddedRight(' ', 22)
+                          << (juce::String(range.start) + " .. " + juce::String(range.end)).paddedRight(' ', 16)
+                          << "default " << range.convertFrom0to1(ranged->getDefaultValue())
+                          << "   " << ranged->getName(64) << "\n";
+            }
+        }
+    }
+    
+    // false (after printing why) if the command line doesn't make sense
+    bool parseArguments(const juce::StringArray& args, Settings& settings, juce::AudioFormatManager& formats)
+    {
+        for (int i = 0; i < args.size(); ++i)
+        {
+            const auto& arg = args[i];
+            const bool hasValue = i + 1 < args.size();
+            
+            if (arg == "--out" && hasValue)         settings.outputFolder = juce::File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+            else if (arg == "--suffix" && hasValue) settings.suffix = args[++i];
+            else if (arg == "--jobs" && hasValue)   settings.numWorkers = juce::jmax(1, args[++i].getIntValue());
+            else if (arg == "--block" && hasValue)  settings.blockSize = juce::jlimit(16, 8192, args[++i].getIntValue());
+            else if (arg == "--rt-check")           settings.checkRealtime = true;
+            else if (arg == "--rt-trap")            settings.checkRealtime = settings.trapRealtime = true;
+            else if (arg == "--mode" && hasValue)
+            {
+                const auto m = args[++i].toLowerCase();
+                if (m != "rtefc" && m != "kmeans")
+                {
+                    std::cout << "unknown engine mode: " << m << "\n";
+                    return false;
+                }
+                settings.parameters.set("engine_mode", m == "rtefc" ? "0" : "1");
+            }
+            else if (arg == "--set" && hasValue)
+            {
+                const auto assignment = args[++i];
+                if (! assignment.containsChar('='))
+                {
+                    std::cout << "expected <id>=<value>, got " << assignment << "\n";
+                    return false;
+                }
+                settings.parameters.set(assignment.upToFirstOccurrenceOf("=", false, false).trim(),
+                                        assignment.fromFirstOccurrenceOf("=", false, false).trim());
+            }
+            else if (arg.startsWith("--"))
+            {
+                std::cout << "unknown option: " << arg << "\n";
+                return false;
+            }
+            else
+            {
+                const auto f = juce::File::getCurrentWorkingDirectory().getChildFile(arg);
+                if (f.isDirectory())
+                {
+                    for (const auto& entry : juce::RangedDirectoryIterator(f, true, formats.getWildcardForAllFormats()))
+                        settings.inputs.add(entry.getFile());
+                }
+                else if (f.existsAsFile())
+                {
+                    settings.inputs.add(f);
+                }
+                else
+                {
+                    std::cout << "no such file: " << arg << "\n";
+                    return false;
+                }
+            }
+        }
+        
+        if (settings.inputs.isEmpty())
+        {
+            printUsage();
+            return false;
+        }
+        return true;
+    }
+    
+    // applies --set values through the parameters, so the processor's listeners see them
+    // exactly as they would host automation. unknown ids and the reset triggers are refused
+    bool applyParameters(RTWavesetsAudioProcessor& processor, const juce::StringPairArray& values)
+    {
+        for (const auto& id : values.getAllKeys())
+        {
+            auto* p = processor.apvts.getParameter(id);
+            if (p == nullptr || id.startsWith("reset_"))
+            {
+                std::cout << "unknown parameter: " << id << " (see --list-params)\n";
+                return false;
+            }
+            
+            const float value = values[id].getFloatValue();
+            p->setValueNotifyingHost(p->convertTo0to1(value));
+        }
+        return true;
+    }
+    
+    struct RenderResult
+    {
+        bool ok = false;
+        juce::String message;
+        double audioSeconds = 0.0;
+        double wallSeconds = 0.0;
+    };
+    
+    juce::File outputFileFor(const juce::File& input, const Settings& settings)
+    {
+        const auto folder = settings.outputFolder == juce::File() ? input.getParentDirectory() : settings.outputFolder;
+        return folder.getChildFile(input.getFileNameWithoutExtension() + settings.suffix + ".wav");
+    }
+    
+    RenderResult renderFile(RTWavesetsAudioProcessor& processor, juce::AudioFormatManager& formats,
+                            const juce::File& input, const juce::File& output, int blockSize, bool realtime)
+    {
+        RenderResult result;
+        const auto start = juce::Time::getHighResolutionTicks();
+        
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor(input));
+        if (reader == nullptr)
+        {
+            result.message = "can't read " + input.getFullPathName();
+            return result;
+        }
+        
+        const double sampleRate = reader->sampleRate;
+        const int numFileChannels = (int) juce::jlimit(1u, (unsigned int) RTWavesetsAudioProcessor::maxChannels, reader->numChannels);
+        const int numChannels = juce::jmax(2, numFileChannels); // mono goes through as stereo
+        const int bitsPerSample = reader->bitsPerSample <= 16 ? 16 : (reader->usesFloatingPointData ? 32 : 24);
+        
+        output.getParentDirectory().createDirectory();
+        output.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(output);
+        if (stream->failedToOpen())
+        {
+            result.message = "can't write " + output.getFullPathName();
+            return result;
+        }
+        
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor(stream.get(), sampleRate,
+                                                                             (unsigned int) numFileChannels,
+                                                                             bitsPerSample, {}, 0));
+        if (writer == nullptr)
+        {
+            result.message = "can't write " + output.getFullPathName();
+            return result;
+        }
+        stream.release(); // the writer owns it now
+        
+        // prepareToPlay resets both engines and the segmenter, so files don't bleed into each other.
+        // a realtime render takes the same path as a live host, background refreshes and all
+        processor.setNonRealtime(! realtime);
+        processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+        
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        
+        for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize)
+        {
+            const int n = (int) juce::jmin((juce::int64) blockSize, reader->lengthInSamples - pos);
+            buffer.setSize(numChannels, n, false, false, true);
+            
+            // mono files feed both inputs
+            reader->read(&buffer, 0, n, pos, true, true);
+            if (numFileChannels == 1)
+                buffer.copyFrom(1, 0, buffer, 0, 0, n);
+            
+            processor.processBlock(buffer, midi);
+            writer->writeFromAudioSampleBuffer(buffer, 0, n);
+        }
+        
+        processor.releaseResources();
+        
+        result.ok = true;
+        result.audioSeconds = (double) reader->lengthInSamples / sampleRate;
+        result.wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return result;
+    }
+    
+    // the files to render and the next one nobody has claimed yet
+    struct WorkQueue
+    {
+        const Settings& settings;
+        std::atomic<int> next { 0 };
+        std::atomic<int> failures { 0 };
+        std::atomic<double> totalAudioSeconds { 0.0 };
+        juce::CriticalSection printLock;
+    };
+    
+    // one processor per worker, reused for every file it picks up
+    class RenderWorker : public juce::Thread
+    {
+    public:
+        RenderWorker(WorkQueue& q, int index)
+            : juce::Thread("Render worker " + juce::String(index)), queue(q)
+        {
+            formats.registerBasicFormats();
+        }
+        
+        bool configure() { return applyParameters(processor, queue.settings.parameters); }
+        
+        void run() override
+        {
+            const auto& inputs = queue.settings.inputs;
+            for (int i = queue.next++; i < inputs.size() && ! threadShouldExit(); i = queue.next++)
+            {
+                const auto& input = inputs.getReference(i);
+                const auto output = outputFileFor(input, queue.settings);
+                const auto result = renderFile(processor, formats, input, output, queue.settings.blockSize,
+                                               queue.settings.checkRealtime);
+                
+                if (result.ok)
+                {
+                    auto total = queue.totalAudioSeconds.load();
+                    while (! queue.totalAudioSeconds.compare_exchange_weak(total, total + result.audioSeconds)) {}
+                }
+                else
+                {
+                    ++queue.failures;
+                }
+                
+                const juce::ScopedLock sl (queue.printLock);
+                if (result.ok)
+                    std::cout << "[" << (i + 1) << "/" << inputs.size() << "] " << output.getFileName()
+                              << "  " << juce::String(result.audioSeconds, 1) << " s of audio, "
+                              << juce::String(result.audioSeconds / juce::jmax(1.0e-9, result.wallSeconds), 1)
+                              << "x real time\n";
+                else
+                    std::cout << "[" << (i + 1) << "/" << inputs.size() << "] failed: " << result.message << "\n";
+            }
+        }
+    
+    private:
+        WorkQueue& queue;
+        juce::AudioFormatManager formats;
+        RTWavesetsAudioProcessor processor;
+    };
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // the processor's parameter state wants a message manager around, even though
+    // nothing here ever runs the message loop
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add(argv[i]);
+    
+    if (args.contains("--list-params"))
+    {
+        listParameters();
+        return 0;
+    }
+    
+    Settings settings;
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+    if (! parseArguments(args, settings, formats))
+        return 1;
+    
+    if (settings.checkRealtime)
+    {
+        if (! RealtimeGuard::isEnabled())
+        {
+            std::cout << "--rt-check needs a build with RTWAVESETS_REALTIME_CHECKS=1 (set in BatchRenderer.jucer)\n";
+            return 1;
+        }
+        RealtimeGuard::reset();
+        RealtimeGuard::setTrapping(settings.trapRealtime);
+    }
+    
+    WorkQueue queue { settings };
+    const int numWorkers = juce::jmin(settings.numWorkers, settings.inputs.size());
+    
+    juce::OwnedArray<RenderWorker> workers;
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto* w = workers.add(new RenderWorker(queue, i));
+        if (! w->configure())
+            return 1;
+    }
+    
+    const auto start = juce::Time::getHighResolutionTicks();
+    for (auto* w : workers)
+        w->startThread();
+    for (auto* w : workers)
+        w->waitForThreadToExit(-1);
+    const double wallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+    
+    std::cout << "\n" << (settings.inputs.size() - queue.failures.load()) << " of " << settings.inputs.size()
+              << " files rendered with " << numWorkers << " workers in " << juce::String(wallSeconds, 1) << " s ("
+              << juce::String(queue.totalAudioSeconds.load() / juce::jmax(1.0e-9, wallSeconds), 1) << "x real time)\n";
+    
+    if (settings.checkRealtime)
+    {
+        std::cout << "\n" << RealtimeGuard::describeReport();
+        if (RealtimeGuard::getNumViolations() > 0)
+        {
+            std::cout << RealtimeGuard::getNumViolations() << " real-time violations after warm-up\n";
+            return 1;
+        }
+    }
+    
+    return queue.failures.load() == 0 ? 0 : 1;
+}
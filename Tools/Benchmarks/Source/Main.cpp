@@ -0,0 +1,645 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Created: 16 Oct 2026 6:04:51pm
+    Author:  Nicholas Boyko
+
+    benchmarks for the waveset hot paths. build the Release configuration,
+    numbers from Debug builds are meaningless. pass --json <file> to also
+    write every row as JSON, e.g. to diff two builds
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <numeric>
+#include "../../../Source/KMeansModel.h"
+#include "../../../Source/CentroidStore.h"
+#include "../../../Source/RTEFC_Engine.h"
+#include "../../../Source/KMeansWindowEngine.h"
+#include "../../../Source/PluginProcessor.h"
+
+namespace
+{
+    // every printed row, kept for the optional JSON report
+    juce::Array<juce::var> reportRows;
+    
+    void report(const juce::String& benchmark, std::initializer_list<std::pair<const char*, juce::var>> fields)
+    {
+        auto row = std::make_unique<juce::DynamicObject>();
+        row->setProperty("benchmark", benchmark);
+        for (const auto& [name, value] : fields)
+            row->setProperty(name, value);
+        reportRows.add(juce::var(row.release()));
+    }
+    
+    // a set of timings in seconds, summarized the way a real-time budget cares about
+    struct Timings
+    {
+        std::vector<double> seconds;
+        
+        void add(juce::int64 startTicks, juce::int64 endTicks)
+        {
+            seconds.push_back(juce::Time::highResolutionTicksToSeconds(endTicks - startTicks));
+        }
+        
+        double percentile(double p)
+        {
+            if (seconds.empty())
+                return 0.0;
+            
+            std::sort(seconds.begin(), seconds.end());
+            const auto i = (size_t) juce::jlimit(0.0, (double) seconds.size() - 1.0, std::ceil(p * (double) seconds.size()) - 1.0);
+            return seconds[i];
+        }
+        
+        double median()  { return percentile(0.5); }
+        double worst()   { return percentile(1.0); }
+        double total() const { return std::accumulate(seconds.begin(), seconds.end(), 0.0); }
+    };
+    
+    // a window of wavesets drawn from a handful of feature blobs, roughly what a
+    // few seconds of pitched material looks like to the k-means engine
+    void fillSyntheticWindow(KMeansRefreshJob& job, int n, juce::Random& rng)
+    {
+        job.n = n;
+        for (int i = 0; i < n; ++i)
+        {
+            const int blob = rng.nextInt(12);
+            auto& x = job.raw[(size_t) i];
+            x[0] = 40.0f + 30.0f * (float) blob + 10.0f * (rng.nextFloat() - 0.5f);
+            x[1] = 0.1f * (float) (blob % 4) + 0.05f * (rng.nextFloat() - 0.5f);
+            for (size_t d = 2; d < x.size(); ++d)
+                x[d] = 0.2f * (float) ((blob + (int) d) % 3) + 0.1f * (rng.nextFloat() - 0.5f);
+            job.slots[(size_t) i] = i;
+            job.serials[(size_t) i] = (juce::uint32) i + 1;
+        }
+        
+        for (size_t d = 0; d < (size_t) featureDimension; ++d)
+        {
+            double s = 0;
+            for (int i = 0; i < n; ++i)
+                s += job.raw[(size_t) i][d];
+            job.mean[d] = (float) (s / n);
+            
+            double v = 0;
+            for (int i = 0; i < n; ++i)
+                v += juce::square(job.raw[(size_t) i][d] - job.mean[d]);
+            job.stdDev[d] = (float) std::sqrt(v / n);
+        }
+    }
+    
+    struct RefreshResult
+    {
+        double medianMicros = 0.0;
+        juce::int64 distances = 0;
+        std::vector<int> assignments;
+    };
+    
+    // cold refreshes, so every method starts from the same farthest-point seeds
+    RefreshResult timeRefresh(const KMeansRefreshJob& job, KMeansAssignment method, int repeats)
+    {
+        KMeansRefresher refresher;
+        refresher.allocate(job.n, job.k);
+        refresher.setAssignmentMethod(method);
+        
+        KMeansModel model;
+        model.allocate(job.n, job.k);
+        
+        std::vector<double> micros;
+        for (int r = 0; r < repeats; ++r)
+        {
+            refresher.reset();
+            const auto start = juce::Time::getHighResolutionTicks();
+            refresher.run(job, model);
+            const auto end = juce::Time::getHighResolutionTicks();
+            micros.push_back(juce::Time::highResolutionTicksToSeconds(end - start) * 1.0e6);
+        }
+        
+        std::sort(micros.begin(), micros.end());
+        return { micros[micros.size() / 2], refresher.getLastDistanceCount(), model.assignments };
+    }
+    
+    void benchmarkKMeansAssignment()
+    {
+        std::cout << "k-means refresh, Lloyd assignment (cold start, up to 16 iterations)\n"
+                  << "    k  window      method    median us     distances   speed-up  same result\n";
+        
+        const std::pair<KMeansAssignment, const char*> methods[] = {
+            { KMeansAssignment::bruteForce, "brute" },
+            { KMeansAssignment::hamerly,    "hamerly" },
+            { KMeansAssignment::elkan,      "elkan" }
+        };
+        
+        juce::Random rng (1234);
+        for (int k : { 8, 32, 64, 128 })
+        {
+            for (int window : { 256, 1024, 4096 })
+            {
+                KMeansRefreshJob job;
+                job.allocate(window);
+                job.epoch = 1;
+                job.k = k;
+                job.iterations = 16;
+                job.lengthWeight = 5.0f;
+                job.warmStart = false;
+                fillSyntheticWindow(job, window, rng);
+                
+                RefreshResult baseline;
+                for (const auto& [method, name] : methods)
+                {
+                    const auto result = timeRefresh(job, method, 15);
+                    if (method == KMeansAssignment::bruteForce)
+                        baseline = result;
+                    
+                    std::cout << juce::String(k).paddedLeft(' ', 5)
+                              << juce::String(window).paddedLeft(' ', 8)
+                              << juce::String(name).paddedLeft(' ', 12)
+                              << juce::String(result.medianMicros, 1).paddedLeft(' ', 13)
+                              << juce::String(result.distances).paddedLeft(' ', 14)
+                              << juce::String(baseline.medianMicros / result.medianMicros, 2).paddedLeft(' ', 10) << "x"
+                              << (result.assignments == baseline.assignments ? "          yes" : "           NO")
+                              << "\n";
+                    
+                    report("kmeans_assignment", { { "k", k }, { "window", window }, { "method", name },
+                                                  { "median_us", result.medianMicros },
+                                                  { "distances", result.distances },
+                                                  { "same_result", result.assignments == baseline.assignments } });
+                }
+            }
+        }
+    }
+    
+    // the pre-SoA search: one feature vector at a time
+    int scalarNearest(const std::vector<FeatureVector>& centroids, const FeatureVector& p)
+    {
+        int best = -1;
+        float bestD2 = std::numeric_limits<float>::max();
+        for (int i = 0; i < (int) centroids.size(); ++i)
+        {
+            float d2 = 0.0f;
+            for (size_t d = 0; d < p.size(); ++d)
+                d2 += juce::square(p[d] - centroids[(size_t) i][d]);
+            if (d2 < bestD2) { bestD2 = d2; best = i; }
+        }
+        return best;
+    }
+    
+    FeatureVector randomFeature(juce::Random& rng)
+    {
+        FeatureVector x;
+        for (auto& v : x)
+            v = 8.0f * rng.nextFloat() - 4.0f;
+        return x;
+    }
+    
+    void benchmarkNearestCentroid()
+    {
+        std::cout << "\nnearest centroid, " << CentroidStore<featureDimension>::simdWidth << " lanes, "
+                  << featureDimension << " features\n"
+                  << "    k    scalar ns   store ns   speed-up  same result\n";
+        
+        juce::Random rng (99);
+        constexpr int numQueries = 20000;
+        std::vector<FeatureVector> queries ((size_t) numQueries);
+        for (auto& q : queries)
+            q = randomFeature(rng);
+        
+        for (int k : { 8, 32, 50, 128, 1024 })
+        {
+            std::vector<FeatureVector> aos ((size_t) k);
+            CentroidStore<featureDimension> store;
+            store.allocate(k);
+            for (auto& c : aos)
+            {
+                c = randomFeature(rng);
+                store.push_back(c);
+            }
+            
+            // the checksum keeps the searches from being optimized away
+            juce::int64 scalarSum = 0, storeSum = 0;
+            auto start = juce::Time::getHighResolutionTicks();
+            for (const auto& q : queries)
+                scalarSum += scalarNearest(aos, q);
+            const double scalarNs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e9 / numQueries;
+            
+            start = juce::Time::getHighResolutionTicks();
+            for (const auto& q : queries)
+                storeSum += store.nearest(q);
+            const double storeNs = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) * 1.0e9 / numQueries;
+            
+            std::cout << juce::String(k).paddedLeft(' ', 5)
+                      << juce::String(scalarNs, 1).paddedLeft(' ', 13)
+                      << juce::String(storeNs, 1).paddedLeft(' ', 11)
+                      << juce::String(scalarNs / storeNs, 2).paddedLeft(' ', 10) << "x"
+                      << (scalarSum == storeSum ? "          yes" : "           NO")
+                      << "\n";
+            
+            report("nearest_centroid", { { "k", k }, { "scalar_ns", scalarNs }, { "store_ns", storeNs },
+                                         { "same_result", scalarSum == storeSum } });
+        }
+    }
+
+    //==============================================================================
+    // wavesets of assorted lengths, levels and shapes, roughly a mix of pitched and noisy input
+    std::vector<juce::AudioBuffer<float>> makeWavesets(int count, int minLength, int maxLength, juce::Random& rng)
+    {
+        std::vector<juce::AudioBuffer<float>> wavesets;
+        wavesets.reserve((size_t) count);
+        for (int i = 0; i < count; ++i)
+        {
+            const int length = minLength + rng.nextInt(maxLength - minLength + 1);
+            const float level = 0.02f + 0.6f * rng.nextFloat();
+            const float noise = 0.3f * rng.nextFloat();
+            const float harmonic = (float) (2 + rng.nextInt(4));
+            
+            juce::AudioBuffer<float> ws (2, length);
+            for (int s = 0; s < length; ++s)
+            {
+                const float phase = juce::MathConstants<float>::twoPi * (float) s / (float) length;
+                const float v = level * (std::sin(phase) + 0.3f * std::sin(harmonic * phase)
+                                         + noise * (2.0f * rng.nextFloat() - 1.0f));
+                ws.setSample(0, s, v);
+                ws.setSample(1, s, v);
+            }
+            wavesets.push_back(std::move(ws));
+        }
+        return wavesets;
+    }
+    
+    void benchmarkRtefc()
+    {
+        std::cout << "\nRTEFC processWaveset, 44.1 kHz\n"
+                  << " clusters   median ns      p99 ns    worst ns\n";
+        
+        juce::Random rng (7);
+        const auto wavesets = makeWavesets(4096, 20, 600, rng);
+        constexpr int numTimed = 20000;
+        
+        for (int target : { 16, 64, 256, 1024, 4096 })
+        {
+            RTEFC_Engine engine;
+            engine.prepare(44100.0);
+            
+            // a tiny radius spawns a cluster for nearly every waveset until the cap is reached
+            engine.setParameters(0.01f, 0.98f, 5.0f, (float) target, 64.0f, false);
+            for (int i = 0; i < 4 * target + 1000; ++i)
+            {
+                engine.processWaveset(wavesets[(size_t) i % wavesets.size()]);
+                if (i % 64 == 0)
+                {
+                    engine.publishVisualization();
+                    if (engine.getNumClusters() >= target)
+                        break;
+                }
+            }
+            
+            Timings t;
+            for (int i = 0; i < numTimed; ++i)
+            {
+                const auto& ws = wavesets[(size_t) (i * 7) % wavesets.size()];
+                const auto start = juce::Time::getHighResolutionTicks();
+                engine.processWaveset(ws);
+                t.add(start, juce::Time::getHighResolutionTicks());
+            }
+            
+            engine.publishVisualization();
+            const int clusters = engine.getNumClusters();
+            
+            std::cout << juce::String(clusters).paddedLeft(' ', 9)
+                      << juce::String(t.median() * 1.0e9, 0).paddedLeft(' ', 12)
+                      << juce::String(t.percentile(0.99) * 1.0e9, 0).paddedLeft(' ', 12)
+                      << juce::String(t.worst() * 1.0e9, 0).paddedLeft(' ', 12)
+                      << "\n";
+            
+            report("rtefc_process_waveset", { { "clusters", clusters },
+                                              { "median_ns", t.median() * 1.0e9 },
+                                              { "p99_ns", t.percentile(0.99) * 1.0e9 },
+                                              { "worst_ns", t.worst() * 1.0e9 } });
+        }
+    }
+    
+    // the refresh as the engine runs it in an offline render, i.e. inline in processWaveset:
+    // the calls that hand the window to k-means show the refresh cost, all calls together
+    // the amortized cost per waveset
+    void benchmarkKMeansRefresh()
+    {
+        constexpr int refreshInterval = 32;
+        constexpr int numRefreshes = 60;
+        
+        std::cout << "\nk-means engine refresh (warm start, every " << refreshInterval << " wavesets, up to 8 iterations)\n"
+                  << "    k  window   median us      p99 us    worst us  ns/waveset\n";
+        
+        juce::Random rng (11);
+        // short enough that the largest window fits in the engine's sample pool
+        const auto wavesets = makeWavesets(8192, 20, 120, rng);
+        
+        for (int k : { 8, 32, 128 })
+        {
+            for (int window : { 256, 1024, 4096 })
+            {
+                KMeansWindowEngine engine;
+                engine.prepare(44100.0, true);
+                engine.setParameters(k, window, refreshInterval, 8, 5.0f, true);
+                
+                // every refreshInterval-th call since prepare() runs a refresh
+                int call = 0;
+                auto next = [&] { return std::cref(wavesets[(size_t) (call++ * 5) % wavesets.size()]); };
+                
+                while (call < window + refreshInterval)
+                    engine.processWaveset(next());
+                
+                Timings refreshes, all;
+                while (refreshes.seconds.size() < (size_t) numRefreshes)
+                {
+                    const bool refreshes_now = (call + 1) % refreshInterval == 0;
+                    const auto& ws = next().get();
+                    const auto start = juce::Time::getHighResolutionTicks();
+                    engine.processWaveset(ws);
+                    const auto end = juce::Time::getHighResolutionTicks();
+                    
+                    all.add(start, end);
+                    if (refreshes_now)
+                        refreshes.add(start, end);
+                }
+                
+                engine.publishVisualization();
+                const double nsPerWaveset = all.total() * 1.0e9 / (double) all.seconds.size();
+                
+                std::cout << juce::String(k).paddedLeft(' ', 5)
+                          << juce::String(engine.getWindowCount()).paddedLeft(' ', 8)
+                          << juce::String(refreshes.median() * 1.0e6, 1).paddedLeft(' ', 12)
+                          << juce::String(refreshes.percentile(0.99) * 1.0e6, 1).paddedLeft(' ', 12)
+                          << juce::String(refreshes.worst() * 1.0e6, 1).paddedLeft(' ', 12)
+                          << juce::String(nsPerWaveset, 0).paddedLeft(' ', 12)
+                          << "\n";
+                
+                report("kmeans_refresh", { { "k", k }, { "window", engine.getWindowCount() },
+                                           { "median_us", refreshes.median() * 1.0e6 },
+                                           { "p99_us", refreshes.percentile(0.99) * 1.0e6 },
+                                           { "worst_us", refreshes.worst() * 1.0e6 },
+                                           { "ns_per_waveset", nsPerWaveset } });
+            }
+        }
+    }
+    
+    //==============================================================================
+    enum class TestSignal { sine, noise, speech, silence };
+    
+    const char* getName(TestSignal s)
+    {
+        switch (s)
+        {
+            case TestSignal::sine:    return "sine";
+            case TestSignal::noise:   return "noise";
+            case TestSignal::speech:  return "speech";
+            case TestSignal::silence: return "silence";
+        }
+        return "";
+    }
+    
+    // fills both channels. "speech" is a crude voice: a glottal pulse train with a wandering
+    // pitch through two formant resonators, chopped into syllables with unvoiced gaps, which
+    // gives the segmenter the irregular waveset lengths real speech does
+    void fillSignal(TestSignal signal, juce::AudioBuffer<float>& buffer, double sampleRate, juce::Random& rng)
+    {
+        const int n = buffer.getNumSamples();
+        auto* out = buffer.getWritePointer(0);
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        
+        switch (signal)
+        {
+            case TestSignal::sine:
+                for (int i = 0; i < n; ++i)
+                    out[i] = 0.5f * (float) std::sin(twoPi * 220.0 * i / sampleRate);
+                break;
+                
+            case TestSignal::noise:
+                for (int i = 0; i < n; ++i)
+                    out[i] = 0.5f * (2.0f * rng.nextFloat() - 1.0f);
+                break;
+                
+            case TestSignal::speech:
+            {
+                double glottalPhase = 0.0;
+                double y1[2] {}, y2[2] {};
+                for (int i = 0; i < n; ++i)
+                {
+                    const double t = i / sampleRate;
+                    const double f0 = 140.0 + 50.0 * std::sin(twoPi * 0.7 * t);
+                    const double syllable = 0.5 - 0.5 * std::cos(twoPi * 4.0 * t);
+                    const bool voiced = std::fmod(t, 1.3) < 1.0;
+                    
+                    glottalPhase += f0 / sampleRate;
+                    double x = 0.0;
+                    if (voiced && glottalPhase >= 1.0)
+                        x = 1.0;
+                    if (! voiced)
+                        x = 0.3 * (2.0 * rng.nextDouble() - 1.0);
+                    glottalPhase -= std::floor(glottalPhase);
+                    
+                    // formants drift with the syllable, like a vowel changing
+                    const double formants[2] = { 500.0 + 300.0 * syllable, 1100.0 + 600.0 * syllable };
+                    double y = 0.0;
+                    for (int f = 0; f < 2; ++f)
+                    {
+                        const double r = 0.97;
+                        const double v = x + 2.0 * r * std::cos(twoPi * formants[f] / sampleRate) * y1[f] - r * r * y2[f];
+                        y2[f] = y1[f];
+                        y1[f] = v;
+                        y += v;
+                    }
+                    out[i] = (float) (0.02 * syllable * y);
+                }
+                break;
+            }
+                
+            case TestSignal::silence:
+                buffer.clear();
+                break;
+        }
+        
+        buffer.copyFrom(1, 0, buffer, 0, 0, n);
+    }
+    
+    void benchmarkProcessBlock()
+    {
+        constexpr int blockSize = 512;
+        constexpr double seconds = 10.0;
+        
+        // realtime, processBlock only segments and plays and the engines run on the
+        // worker pool; offline they run inline, so that row is the whole pipeline
+        std::cout << "\nprocessBlock, " << blockSize << "-sample blocks, " << seconds << " s per row\n"
+                  << "  engine  offline   signal       rate   ns/sample      p99 us    worst us   budget us  p99 load\n";
+        
+        juce::Random rng (3);
+        for (bool offline : { false, true })
+        for (int engineMode : { 0, 1 })
+        {
+            for (auto signal : { TestSignal::sine, TestSignal::noise, TestSignal::speech, TestSignal::silence })
+            {
+                for (double sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+                {
+                    juce::AudioBuffer<float> input (2, (int) (seconds * sampleRate));
+                    fillSignal(signal, input, sampleRate, rng);
+                    
+                    RTWavesetsAudioProcessor processor;
+                    auto* mode = processor.apvts.getParameter("engine_mode");
+                    mode->setValueNotifyingHost(mode->convertTo0to1((float) engineMode));
+                    processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+                    processor.setNonRealtime(offline);
+                    processor.prepareToPlay(sampleRate, blockSize);
+                    
+                    juce::AudioBuffer<float> block (2, blockSize);
+                    juce::MidiBuffer midi;
+                    Timings t;
+                    for (int pos = 0; pos + blockSize <= input.getNumSamples(); pos += blockSize)
+                    {
+                        for (int ch = 0; ch < 2; ++ch)
+                            block.copyFrom(ch, 0, input, ch, pos, blockSize);
+                        
+                        const auto start = juce::Time::getHighResolutionTicks();
+                        processor.processBlock(block, midi);
+                        t.add(start, juce::Time::getHighResolutionTicks());
+                    }
+                    processor.releaseResources();
+                    
+                    const double nsPerSample = t.total() * 1.0e9 / ((double) t.seconds.size() * blockSize);
+                    const double budget = blockSize / sampleRate;
+                    const auto engineName = engineMode == 0 ? "rtefc" : "kmeans";
+                    
+                    std::cout << juce::String(engineName).paddedLeft(' ', 8)
+                              << juce::String(offline ? "yes" : "no").paddedLeft(' ', 9)
+                              << juce::String(getName(signal)).paddedLeft(' ', 9)
+                              << juce::String((int) sampleRate).paddedLeft(' ', 11)
+                              << juce::String(nsPerSample, 1).paddedLeft(' ', 12)
+                              << juce::String(t.percentile(0.99) * 1.0e6, 1).paddedLeft(' ', 12)
+                              << juce::String(t.worst() * 1.0e6, 1).paddedLeft(' ', 12)
+                              << juce::String(budget * 1.0e6, 0).paddedLeft(' ', 12)
+                              << juce::String(100.0 * t.percentile(0.99) / budget, 2).paddedLeft(' ', 9) << "%"
+                              << "\n";
+                    
+                    report("process_block", { { "engine", engineName }, { "offline", offline }, { "signal", getName(signal) },
+                                              { "sample_rate", sampleRate }, { "block_size", blockSize },
+                                              { "ns_per_sample", nsPerSample },
+                                              { "p99_us", t.percentile(0.99) * 1.0e6 },
+                                              { "worst_us", t.worst() * 1.0e6 },
+                                              { "budget_us", budget * 1.0e6 } });
+                }
+            }
+        }
+    }
+    
+    // third-order ambisonics at 48 kHz: every channel group segments and clusters on its
+    // own, so this is where the worker pool (realtime) and the parallel blocks (offline)
+    // have to carry the load. loads are per block, ns are per sample of one channel
+    void benchmarkMultichannel()
+    {
+        constexpr int numChannels = RTWavesetsAudioProcessor::maxChannels;
+        constexpr int blockSize = 512;
+        constexpr double sampleRate = 48000.0;
+        constexpr double seconds = 10.0;
+        
+        std::cout << "\nprocessBlock, " << numChannels << " channels, " << blockSize << "-sample blocks, " << seconds << " s per row\n"
+                  << "  engine  offline      linking   signal   ns/sample      p99 us   budget us  p99 load\n";
+        
+        juce::Random rng (4);
+        for (bool offline : { false, true })
+        for (int engineMode : { 0, 1 })
+        for (int linking : { 0, 1 })
+        {
+            for (auto signal : { TestSignal::noise, TestSignal::speech })
+            {
+                // each channel hears the signal a little later than the one before, so no two
+                // groups cut their wavesets at the same moments
+                juce::AudioBuffer<float> source (2, (int) (seconds * sampleRate));
+                fillSignal(signal, source, sampleRate, rng);
+                constexpr int channelDelay = 37;
+                
+                RTWavesetsAudioProcessor processor;
+                auto* mode = processor.apvts.getParameter("engine_mode");
+                mode->setValueNotifyingHost(mode->convertTo0to1((float) engineMode));
+                auto* link = processor.apvts.getParameter("channel_link");
+                link->setValueNotifyingHost(link->convertTo0to1((float) linking));
+                processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+                processor.setNonRealtime(offline);
+                processor.prepareToPlay(sampleRate, blockSize);
+                
+                juce::AudioBuffer<float> block (numChannels, blockSize);
+                juce::MidiBuffer midi;
+                Timings t;
+                for (int pos = numChannels * channelDelay; pos + blockSize <= source.getNumSamples(); pos += blockSize)
+                {
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        block.copyFrom(ch, 0, source, ch % 2, pos - ch * channelDelay, blockSize);
+                    
+                    const auto start = juce::Time::getHighResolutionTicks();
+                    processor.processBlock(block, midi);
+                    t.add(start, juce::Time::getHighResolutionTicks());
+                }
+                processor.releaseResources();
+                
+                const double nsPerSample = t.total() * 1.0e9 / ((double) t.seconds.size() * blockSize * numChannels);
+                const double budget = blockSize / sampleRate;
+                const auto engineName = engineMode == 0 ? "rtefc" : "kmeans";
+                const auto linkingName = linking == 0 ? "pairs" : "independent";
+                
+                std::cout << juce::String(engineName).paddedLeft(' ', 8)
+                          << juce::String(offline ? "yes" : "no").paddedLeft(' ', 9)
+                          << juce::String(linkingName).paddedLeft(' ', 13)
+                          << juce::String(getName(signal)).paddedLeft(' ', 9)
+                          << juce::String(nsPerSample, 1).paddedLeft(' ', 12)
+                          << juce::String(t.percentile(0.99) * 1.0e6, 1).paddedLeft(' ', 12)
+                          << juce::String(budget * 1.0e6, 0).paddedLeft(' ', 12)
+                          << juce::String(100.0 * t.percentile(0.99) / budget, 2).paddedLeft(' ', 9) << "%"
+                          << "\n";
+                
+                report("multichannel", { { "engine", engineName }, { "offline", offline }, { "linking", linkingName },
+                                         { "signal", getName(signal) }, { "channels", numChannels },
+                                         { "sample_rate", sampleRate }, { "block_size", blockSize },
+                                         { "ns_per_sample", nsPerSample },
+                                         { "p99_us", t.percentile(0.99) * 1.0e6 },
+                                         { "budget_us", budget * 1.0e6 } });
+            }
+        }
+    }
+    
+    void writeReport(const juce::File& file)
+    {
+        auto root = std::make_unique<juce::DynamicObject>();
+        root->setProperty("simd_width", CentroidStore<featureDimension>::simdWidth);
+        root->setProperty("feature_dimension", featureDimension);
+        root->setProperty("time", juce::Time::getCurrentTime().toISO8601(true));
+        root->setProperty("rows", reportRows);
+        
+        if (file.replaceWithText(juce::JSON::toString(juce::var(root.release()))))
+            std::cout << "\nwrote " << file.getFullPathName() << "\n";
+        else
+            std::cout << "\ncouldn't write " << file.getFullPathName() << "\n";
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // the plugin processor's parameter state wants a message manager around
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    
+    juce::File jsonFile;
+    for (int i = 1; i + 1 < argc; ++i)
+        if (juce::String(argv[i]) == "--json")
+            jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[i + 1]);
+    
+    benchmarkKMeansAssignment();
+    benchmarkNearestCentroid();
+    benchmarkRtefc();
+    benchmarkKMeansRefresh();
+    benchmarkProcessBlock();
+    benchmarkMultichannel();
+    
+    if (jsonFile != juce::File())
+        writeReport(jsonFile);
+    
+    return 0;
+}